@@ -77,7 +77,67 @@ void random_area_sampler::sample(vec_vec_f32_t& samples, const cv::Mat& image) c
     }
 }
 
+// -----------------------------------------------------------------------------------------------------------------------
+
+void stroke_sampler::setParameters(ptree &params)
+{
+    _numSamples = parse<uint>(params, "num_samples", 625);
+}
+
+// expects a single channel 8 bit image with white background, as passed to the generators
+void stroke_sampler::sample(vec_vec_f32_t& samples, const cv::Mat& image) const
+{
+    assert(image.type() == CV_8UC1);
+
+    // inverted such that the background is 0, the sum over a region
+    // is then 0 if and only if no stroke goes through it
+    cv::Mat_<unsigned char> inverted = 255 - image;
+    cv::Mat_<int> integral;
+    cv::integral(inverted, integral, CV_32S);
+
+    // bounding box of the strokes
+    int minX = inverted.cols, minY = inverted.rows, maxX = -1, maxY = -1;
+    for (int r = 0; r < inverted.rows; r++)
+        for (int c = 0; c < inverted.cols; c++)
+        {
+            if (inverted(r, c) == 0) continue;
+            minX = std::min(minX, c);
+            maxX = std::max(maxX, c);
+            minY = std::min(minY, r);
+            maxY = std::max(maxY, r);
+        }
+
+    // blank image, nothing to sample
+    if (maxX < 0) return;
+
+    uint numSamples1D = std::ceil(std::sqrt(static_cast<float>(_numSamples)));
+    float stepX = (maxX - minX + 1) / static_cast<float>(numSamples1D);
+    float stepY = (maxY - minY + 1) / static_cast<float>(numSamples1D);
+
+    for (uint x = 0; x < numSamples1D; x++) {
+        for (uint y = 0; y < numSamples1D; y++) {
+
+            // cell of this point, at least a pixel wide
+            cv::Rect cell(minX + static_cast<int>(x*stepX), minY + static_cast<int>(y*stepY),
+                          std::max(1, static_cast<int>(stepX)), std::max(1, static_cast<int>(stepY)));
+            cell &= cv::Rect(0, 0, inverted.cols, inverted.rows);
+
+            int cellsum = integral(cell.tl())
+                    + integral(cell.br())
+                    - integral(cell.y, cell.x + cell.width)
+                    - integral(cell.y + cell.height, cell.x);
+            if (cellsum == 0) continue;
+
+            vec_f32_t p(2);
+            p[0] = cell.x + cell.width / 2;
+            p[1] = cell.y + cell.height / 2;
+            samples.push_back(p);
+        }
+    }
+}
+
 bool gridsampler_registered = ImageSampler::register_sampler<grid_sampler>("grid");
 bool randomsampler_registered = ImageSampler::register_sampler<random_area_sampler>("random_area");
+bool strokesampler_registered = ImageSampler::register_sampler<stroke_sampler>("stroke");
 
 } // end namespace
@@ -0,0 +1,167 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "doc_reorder.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+namespace imdb {
+
+namespace {
+
+// contribution of a term with degree d in a partition of n documents to the
+// estimated cost (in bits) of storing the gaps of its posting list
+inline float gap_cost(int d, size_t n)
+{
+    return d * std::log(static_cast<float>(n) / (d + 1));
+}
+
+// reduction of the cost of a term when one of its documents is moved from a
+// partition of size n_from (degree d_from) to a partition of size n_to (degree d_to)
+inline float move_gain(int d_from, int d_to, size_t n_from, size_t n_to)
+{
+    return (gap_cost(d_from, n_from) + gap_cost(d_to, n_to)) - (gap_cost(d_from - 1, n_from) + gap_cost(d_to + 1, n_to));
+}
+
+struct bisection
+{
+    bisection(const vector<vec_u32_t>& doc_terms, uint32_t num_terms, size_t min_partition, size_t iterations)
+        : _docTerms(doc_terms)
+        , _degreeA(num_terms, 0)
+        , _degreeB(num_terms, 0)
+        , _minPartition(std::max<size_t>(min_partition, 2))
+        , _iterations(iterations)
+    {}
+
+    // orders docs[begin, end)
+    void operator()(vec_u32_t& docs, size_t begin, size_t end)
+    {
+        if (end - begin <= _minPartition) return;
+
+        const size_t mid = begin + (end - begin) / 2;
+        const size_t nA = mid - begin;
+        const size_t nB = end - mid;
+
+        for (size_t i = begin; i < mid; i++) add_degrees(docs[i], _degreeA, 1);
+        for (size_t i = mid; i < end; i++) add_degrees(docs[i], _degreeB, 1);
+
+        vector<pair<float, uint32_t> > gains(end - begin);
+
+        for (size_t iteration = 0; iteration < _iterations; iteration++)
+        {
+            // gain of moving each document to the other partition
+            #pragma omp parallel for schedule(dynamic, 64)
+            for (int i = 0; i < static_cast<int>(gains.size()); i++)
+            {
+                uint32_t doc = docs[begin + i];
+                bool inA = (begin + i < mid);
+                const vec_u32_t& terms = _docTerms[doc];
+
+                float gain = 0;
+                for (size_t k = 0; k < terms.size(); k++)
+                {
+                    uint32_t t = terms[k];
+                    gain += inA ? move_gain(_degreeA[t], _degreeB[t], nA, nB) : move_gain(_degreeB[t], _degreeA[t], nB, nA);
+                }
+                gains[i] = std::make_pair(gain, doc);
+            }
+
+            std::sort(gains.begin(), gains.begin() + nA, std::greater<pair<float, uint32_t> >());
+            std::sort(gains.begin() + nA, gains.end(), std::greater<pair<float, uint32_t> >());
+
+            // swap the pairs of documents that profit most from being moved
+            size_t swapped = 0;
+            for (size_t i = 0; i < nA && i < nB; i++)
+            {
+                if (gains[i].first + gains[nA + i].first <= 0) break;
+                std::swap(gains[i], gains[nA + i]);
+
+                add_degrees(gains[i].second, _degreeB, -1);
+                add_degrees(gains[i].second, _degreeA, 1);
+                add_degrees(gains[nA + i].second, _degreeA, -1);
+                add_degrees(gains[nA + i].second, _degreeB, 1);
+                swapped++;
+            }
+
+            for (size_t i = 0; i < gains.size(); i++) docs[begin + i] = gains[i].second;
+            if (!swapped) break;
+        }
+
+        // reset the degrees of all terms of this partition, the
+        // recursive calls only touch the terms of their subsets
+        for (size_t i = begin; i < mid; i++) add_degrees(docs[i], _degreeA, -1);
+        for (size_t i = mid; i < end; i++) add_degrees(docs[i], _degreeB, -1);
+
+        (*this)(docs, begin, mid);
+        (*this)(docs, mid, end);
+    }
+
+private:
+
+    void add_degrees(uint32_t doc, vector<int>& degrees, int delta)
+    {
+        const vec_u32_t& terms = _docTerms[doc];
+        for (size_t k = 0; k < terms.size(); k++) degrees[terms[k]] += delta;
+    }
+
+    const vector<vec_u32_t>& _docTerms;
+    vector<int> _degreeA;
+    vector<int> _degreeB;
+    size_t _minPartition;
+    size_t _iterations;
+};
+
+} // end anonymous namespace
+
+
+void bisection_order(const InvertedIndex& index, vec_u32_t& order, size_t min_partition, size_t iterations)
+{
+    // forward index, i.e. the terms of each document
+    vector<vec_u32_t> docTerms(index.num_documents());
+    const vector<vector<InvertedIndex::doc_freq_pair> >& lists = index.doc_frequency_list();
+    for (uint32_t t = 0; t < index.num_terms(); t++)
+    {
+        for (size_t i = 0; i < lists[t].size(); i++) docTerms[lists[t][i].first].push_back(t);
+    }
+
+    order.resize(index.num_documents());
+    for (uint32_t d = 0; d < index.num_documents(); d++) order[d] = d;
+
+    bisection bisect(docTerms, index.num_terms(), min_partition, iterations);
+    bisect(order, 0, order.size());
+}
+
+
+double average_gap_bits(const InvertedIndex& index)
+{
+    const vector<vector<InvertedIndex::doc_freq_pair> >& lists = index.doc_frequency_list();
+
+    double bits = 0;
+    uint64_t numPostings = 0;
+    for (size_t t = 0; t < lists.size(); t++)
+    {
+        uint32_t previous = 0;
+        for (size_t i = 0; i < lists[t].size(); i++)
+        {
+            // gaps are >= 1, the first id is coded as gap to -1
+            uint32_t gap = lists[t][i].first - previous + (i == 0 ? 1 : 0);
+            previous = lists[t][i].first;
+
+            // an Elias-gamma code takes 2*floor(log2(gap)) + 1 bits
+            uint32_t log2gap = 0;
+            while (gap >>= 1) log2gap++;
+            bits += 2 * log2gap + 1;
+        }
+        numPostings += lists[t].size();
+    }
+    return numPostings ? bits / numPostings : 0;
+}
+
+} // end namespace imdb
@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef DOC_REORDER_HPP
+#define DOC_REORDER_HPP
+
+#include "types.hpp"
+#include "inverted_index.hpp"
+
+namespace imdb {
+
+/**
+ * @addtogroup search
+ * @{
+ */
+
+
+/**
+ * @brief Computes a document order using recursive graph bisection.
+ *
+ * The documents are split recursively into two halves, in each step documents are swapped between
+ * the halves such that documents sharing many terms end up in the same half (see Dhulipala et al.,
+ * 'Compressing Graphs and Indexes with Recursive Graph Bisection', KDD 2016). Visually similar images
+ * thus get nearby ids, which gives small gaps between the ids stored in a posting list. The result can
+ * be passed to InvertedIndex::reorder().
+ *
+ * @param index Index whose documents are ordered, the posting lists must be in memory
+ * @param order Resulting permutation, order[i] is the current id of the document that should get id i
+ * @param min_partition Partitions with at most this many documents are not split any further
+ * @param iterations Maximum number of swap iterations per bisection step
+ */
+void bisection_order(const InvertedIndex& index, vec_u32_t& order, size_t min_partition = 16, size_t iterations = 20);
+
+
+/**
+ * @brief Average number of bits per posting if the document ids were stored as Elias-gamma coded gaps.
+ *
+ * Used to judge the effect of a document order: the smaller the gaps between consecutive ids of
+ * a posting list, the better the lists compress.
+ */
+double average_gap_bits(const InvertedIndex& index);
+
+
+/** @} */
+
+} // end namespace imdb
+
+#endif // DOC_REORDER_HPP
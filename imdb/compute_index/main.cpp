@@ -23,6 +23,7 @@ the terms of the BSD license (see the LICENSE file).
 #include <distance.hpp>
 #include <inverted_index.hpp>
 #include <tf_idf.hpp>
+#include <doc_reorder.hpp>
 //util/
 #include <kmeans.hpp>
 
@@ -38,10 +39,14 @@ public:
         , _co_histvwfile("histvw"            , "h", "filename to vector of histograms of visual words [required]")
         , _co_output("output"                , "o", "filename of the output index file [required]")
         , _co_tfidf("tfidf"                  , "t", "two strings specifying tf and idf function to be used (eg. -t constant constant) [required]")
+        , _co_convert("convert"              , "c", "filename of an existing index file (e.g. in the legacy format), converts it to the current file format and stores it in the output file. -h and -t are not used in this case")
+        , _co_reorder("reorder"              , "r", "document reordering method, assigns nearby ids to similar documents before saving (results still refer to the filelist order): 'bisection' (recursive graph bisection) [optional]")
     {
         add(_co_histvwfile);
         add(_co_output);
         add(_co_tfidf);
+        add(_co_convert);
+        add(_co_reorder);
     }
 
 
@@ -53,6 +58,24 @@ public:
         string in_histvw;
         string in_output;
         vector<string> in_tfidf;
+        string in_convert;
+        string in_reorder;
+
+        if (_co_reorder.parse_single<string>(args, in_reorder) && in_reorder != "bisection")
+        {
+            std::cerr << "compute_index: unknown reordering method " << in_reorder << std::endl;
+            return false;
+        }
+
+        if (_co_convert.parse_single<string>(args, in_convert))
+        {
+            if (!_co_output.parse_single<string>(args, in_output))
+            {
+                print();
+                return false;
+            }
+            return convert(in_convert, in_output, in_reorder);
+        }
 
         // check that the required options are available
         if (!_co_histvwfile.parse_single<string>(args, in_histvw) ||
@@ -96,6 +119,7 @@ public:
             std::cout << "compute_index: finalizing" << std::endl;
             index.finalize(index, *tf, *idf);
             //index.apply_tfidf(index, *tf, *idf);
+            if (!in_reorder.empty()) reorder(index, in_reorder);
             std::cout << "compute_index: saving" << std::endl;
             index.save(in_output);
         }
@@ -115,9 +139,46 @@ public:
 
 private:
 
+    void reorder(InvertedIndex& index, const string& method)
+    {
+        std::cout << "compute_index: reordering documents (" << method << "), "
+                  << average_gap_bits(index) << " bits per posting before" << std::endl;
+
+        QTime time;
+        time.start();
+
+        vec_u32_t order;
+        bisection_order(index, order);
+        index.reorder(order);
+
+        std::cout << "compute_index: reordering took " << (time.elapsed() / 1000) << "s, "
+                  << average_gap_bits(index) << " bits per posting after" << std::endl;
+    }
+
+    bool convert(const string& in_index, const string& in_output, const string& in_reorder)
+    {
+        try {
+            std::cout << "compute_index: converting " << in_index << std::endl;
+            InvertedIndex index;
+            index.load(in_index);
+            if (!in_reorder.empty()) reorder(index, in_reorder);
+            index.save(in_output);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "compute_index: error: " << e.what() << std::endl;
+            return false;
+        }
+
+        std::cout << "compute_index: done." << std::endl;
+        return true;
+    }
+
     CmdOption _co_histvwfile;
     CmdOption _co_output;
     CmdOption _co_tfidf;
+    CmdOption _co_convert;
+    CmdOption _co_reorder;
 };
 
 
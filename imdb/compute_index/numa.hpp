@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <boost/utility.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Helpers for placing memory and threads on the nodes of a NUMA machine.
+ *
+ * On machines with a single node (and on platforms without NUMA support) all functions
+ * behave as if there was exactly one node 0.
+ */
+namespace numa {
+
+    /// Number of NUMA nodes of the machine, at least 1
+    int num_nodes();
+
+    /// Node of the processor the calling thread is currently running on
+    int current_node();
+
+    /// Restricts the calling thread to the processors of the given node
+    /// @return false if the thread could not be pinned
+    bool pin_current_thread(int node);
+
+} // end namespace numa
+
+
+/**
+ * @ingroup search
+ * @brief Page aligned, zero initialized memory placed on a given NUMA node and optionally backed by large pages.
+ *
+ * Large pages (2MB instead of 4KB on x86) reduce the number of TLB misses for random accesses into large
+ * arrays, such as the accumulation of scores in InvertedIndex::score(). On Windows large pages require
+ * the 'Lock pages in memory' privilege (SeLockMemoryPrivilege) for the user running the process, if they
+ * are not available the buffer silently falls back to normal pages, see large_pages(). On Linux the buffer
+ * is aligned to 2MB and marked for transparent huge pages instead.
+ */
+class PageBuffer : public boost::noncopyable
+{
+public:
+
+    /// Pass as node to distribute the pages of the buffer round-robin over all nodes
+    static const int interleave = -1;
+
+    /**
+     * @param bytes Size of the buffer
+     * @param node NUMA node the memory is placed on, or interleave
+     * @param large_pages Try to back the buffer by large pages, not supported together with interleave
+     * @throw std::bad_alloc if no memory could be allocated
+     */
+    PageBuffer(size_t bytes, int node, bool large_pages);
+
+    ~PageBuffer();
+
+    void*       data()       { return _data; }
+    const void* data() const { return _data; }
+    size_t      size() const { return _size; }
+
+    /// True if the buffer is actually backed by large pages
+    bool large_pages() const { return _largePages; }
+
+private:
+
+    void*  _data;
+    size_t _size;
+    bool   _largePages;
+};
+
+} // end namespace imdb
+
+#endif // NUMA_HPP
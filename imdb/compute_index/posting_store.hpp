@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef POSTING_STORE_HPP
+#define POSTING_STORE_HPP
+
+#include <fstream>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Gives access to posting lists that are kept on disk instead of in main memory.
+ *
+ * Used by InvertedIndex::load_tiered(): the posting lists of rarely used ('cold') terms are not read
+ * into memory, the ColdPostingStore only remembers where in the index file they are located. During
+ * a query, the lists of all cold query terms are fetched at once using fetch(), which issues the
+ * reads in parallel from a small pool of file handles, before the actual scoring starts.
+ *
+ * Note: instances are noncopyable since they internally open files. Fetching is thread-safe.
+ */
+class ColdPostingStore : public boost::noncopyable
+{
+public:
+
+    typedef pair<uint32_t, float> doc_freq_pair;
+
+    /// Position of a single posting list in the index file
+    struct location
+    {
+        int64_t  frequency_offset;  // file offset of the first doc_freq_pair
+        int64_t  weight_offset;     // file offset of the first tf-idf weight
+        uint32_t length;            // number of entries in the posting list
+    };
+
+    /// @param filename Index file the posting lists are read from
+    /// @param num_terms Total number of terms in the vocabulary
+    ColdPostingStore(const string& filename, uint32_t num_terms);
+
+    /// Mark the posting list of term_id as cold, its entries are located at loc in the index file
+    void add(uint32_t term_id, const location& loc);
+
+    /// True if the posting list of term_id is kept on disk
+    inline bool contains(uint32_t term_id) const { return _cold[term_id]; }
+
+    /**
+     * @brief Reads the posting lists of all passed terms from disk.
+     *
+     * All reads are issued at once and run in parallel, so the latency of a query that hits several
+     * cold terms is roughly that of the slowest single read.
+     *
+     * @param terms Terms to fetch, all of them must be contained in the store
+     * @param frequencies frequencies[i] receives the doc/frequency pairs of terms[i]
+     * @param weights weights[i] receives the tf-idf weights of terms[i]
+     * @throw std::ios_base::failure in case reading fails
+     */
+    void fetch(const vector<uint32_t>& terms, vector<vector<doc_freq_pair> >& frequencies, vector<vector<float> >& weights) const;
+
+    /// Number of terms whose posting lists are kept on disk
+    inline size_t num_terms() const { return _numTerms; }
+
+    /// Total number of postings kept on disk
+    inline uint64_t num_postings() const { return _numPostings; }
+
+private:
+
+    shared_ptr<std::ifstream> acquire() const;
+    void release(const shared_ptr<std::ifstream>& stream) const;
+
+    string            _filename;
+    vector<location>  _locations;
+    vector<bool>      _cold;
+    size_t            _numTerms;
+    uint64_t          _numPostings;
+
+    // file handles not currently in use by a fetch(), each reading
+    // thread takes one out of the pool and puts it back when done
+    mutable vector<shared_ptr<std::ifstream> > _streams;
+    mutable boost::mutex                       _mutex;
+};
+
+} // end namespace imdb
+
+#endif // POSTING_STORE_HPP
@@ -0,0 +1,153 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "batch_search.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <cassert>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <opencv2/highgui/highgui.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "numa.hpp"
+
+namespace imdb {
+
+BatchSearch::BatchSearch(const ImageSearcher& searcher, const FileList& query_files, size_t num_results)
+    : _query(boost::bind(&ImageSearcher::query, &searcher, _1, _2, _3, _4, _5))
+    , _queryFiles(query_files)
+    , _numResults(num_results)
+    , _deadlineMs(0)
+    , _latency(0)
+    , _numThreads(0)
+    , _next(0)
+    , _error(false)
+    , _numWritten(0)
+{}
+
+
+BatchSearch::BatchSearch(const query_fn& query, const FileList& query_files, size_t num_results)
+    : _query(query)
+    , _queryFiles(query_files)
+    , _numResults(num_results)
+    , _deadlineMs(0)
+    , _latency(0)
+    , _numThreads(0)
+    , _next(0)
+    , _error(false)
+    , _numWritten(0)
+{}
+
+
+bool BatchSearch::run(const vector<size_t>& queries, int num_threads, const result_handler& handler, LatencyReport* latency)
+{
+    assert(num_threads > 0);
+
+    _queries = queries;
+    _handler = handler;
+    _latency = latency;
+    _numThreads = num_threads;
+    _next = 0;
+    _error = false;
+    _pending = queue_t();
+    _numWritten = 0;
+
+    boost::thread_group pool;
+    for (int i = 0; i < num_threads; i++)
+    {
+        pool.add_thread(new boost::thread(boost::bind(&BatchSearch::thread_main, this, i)));
+    }
+    pool.join_all();
+
+    return !_error;
+}
+
+
+size_t BatchSearch::num_finished() const
+{
+    boost::lock_guard<boost::mutex> lock(_outputMutex);
+    return _numWritten;
+}
+
+
+void BatchSearch::thread_main(int thread_id)
+{
+#ifdef _OPENMP
+    // the pool is the parallelism, don't start a team of threads per query on top
+    if (_numThreads > 1) omp_set_num_threads(1);
+#endif
+
+    // spread the pool over the nodes, queries then read the index replica
+    // on their own node (see BofSearchManager parameter "numa")
+    if (numa::num_nodes() > 1) numa::pin_current_thread(thread_id % numa::num_nodes());
+
+    while (!_error)
+    {
+        size_t position;
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            if (_next == _queries.size()) break;
+            position = _next++;
+        }
+
+        const string filename = _queryFiles.get_filename(_queries[position]);
+        shared_ptr<finished_query> query(new finished_query());
+
+        try {
+            const Deadline deadline = Deadline::in_ms(_deadlineMs);
+
+            Stopwatch watch;
+            mat_8uc3_t image = cv::imread(filename, 1);
+            if (image.empty()) throw std::runtime_error("could not read image");
+            query->timings.ms[query_timings::Decode] = watch.elapsed_ms();
+
+            query->timings.truncated = !_query(image, _numResults, query->results, &query->timings, deadline);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "BatchSearch: query " << filename << " failed: " << e.what() << std::endl;
+            _error = true;
+            return;
+        }
+
+        push_results(position, query);
+    }
+}
+
+
+void BatchSearch::push_results(size_t position, const shared_ptr<finished_query>& query)
+{
+    boost::lock_guard<boost::mutex> lock(_outputMutex);
+
+    _pending.push(queue_element(position, query));
+
+    // hand over everything that is now in order
+    while (!_pending.empty() && _pending.top().first == _numWritten)
+    {
+        finished_query& next = *_pending.top().second;
+        const size_t index = _queries[_numWritten];
+
+        Stopwatch watch;
+        _handler(index, next.results);
+        next.timings.ms[query_timings::Write] = watch.elapsed_ms();
+
+        if (_latency) _latency->add(_queryFiles.get_relative_filename(index), next.timings);
+
+        _pending.pop();
+        _numWritten++;
+    }
+}
+
+} // end namespace imdb
@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef BATCH_SEARCH_HPP
+#define BATCH_SEARCH_HPP
+
+#include <queue>
+
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+#include "filelist.hpp"
+#include "image_searcher.hpp"
+#include "query_timings.hpp"
+#include "deadline.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Runs a list of query images on a pool of threads.
+ *
+ * Each thread repeatedly takes the next query, reads the image and runs the complete query pipeline
+ * (e.g. of an ImageSearcher) on it, such that the feature extraction of some queries overlaps with the
+ * scoring of others. The results are handed to a callback strictly in the order of the queries
+ * (results finished early are buffered until all preceding queries are done), so the output of a
+ * batch does not depend on the number of threads.
+ *
+ * The time spent in each stage of every query, including decoding the image and handing over the
+ * results (Write), can be collected in a LatencyReport.
+ *
+ * OpenMP parallelism inside a query (quantization) is switched off in the pool threads as the pool
+ * already keeps all processors busy.
+ *
+ * With set_deadline() every query gets a time budget counted from the moment a thread takes it (before
+ * decoding the image), queries running out of it return truncated results, see Deadline.
+ */
+class BatchSearch : public boost::noncopyable
+{
+public:
+
+    /// Called once per query with the index of the query image in the filelist and its results
+    typedef boost::function<void (size_t query, const vector<dist_idx_t>& results)> result_handler;
+
+    /// Complete query pipeline of a single image, returns false if the results were truncated by the deadline, see ImageSearcher::query()
+    typedef boost::function<bool (const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results, query_timings* timings,
+                                  const Deadline& deadline)> query_fn;
+
+    /**
+     * @param searcher Query pipeline, must outlive the batch
+     * @param query_files Filelist of the query images
+     * @param num_results Number of results per query
+     */
+    BatchSearch(const ImageSearcher& searcher, const FileList& query_files, size_t num_results);
+
+    /**
+     * @param query Query pipeline, e.g. bound to FusedSearcher::query(), called concurrently from the pool threads
+     * @param query_files Filelist of the query images
+     * @param num_results Number of results per query
+     */
+    BatchSearch(const query_fn& query, const FileList& query_files, size_t num_results);
+
+    /**
+     * @brief Runs the given queries and blocks until all of them are done.
+     * @param queries Indices into the query filelist of the images to be searched
+     * @param num_threads Number of threads running queries, must be > 0
+     * @param handler Callback receiving the results, calls are serialized and in the order of \p queries
+     * @param latency [optional] receives the timings of each query in the order of \p queries
+     * @return false if a query failed, the remaining queries are not run in that case
+     */
+    bool run(const vector<size_t>& queries, int num_threads, const result_handler& handler, LatencyReport* latency = 0);
+
+    /// Number of queries whose results have been passed to the handler so far
+    size_t num_finished() const;
+
+    /// Time budget of each query in milliseconds, 0 (the default) for none
+    void set_deadline(double ms) {_deadlineMs = ms;}
+
+private:
+
+    void thread_main(int thread_id);
+
+    // results and timings of a finished query
+    struct finished_query
+    {
+        vector<dist_idx_t> results;
+        query_timings      timings;
+    };
+
+    void push_results(size_t position, const shared_ptr<finished_query>& query);
+
+    query_fn             _query;
+    const FileList&      _queryFiles;
+    size_t               _numResults;
+    double               _deadlineMs;
+
+    vector<size_t>       _queries;
+    result_handler       _handler;
+    LatencyReport*       _latency;
+    int                  _numThreads;
+
+    // position in _queries of the next query to be taken by a thread
+    size_t               _next;
+    volatile bool        _error;
+    mutable boost::mutex _mutex;
+
+    // results finished out of order wait here until all preceding ones have been passed to the handler
+    typedef std::pair<size_t, shared_ptr<finished_query> > queue_element;
+    typedef std::priority_queue<queue_element, vector<queue_element>, std::greater<queue_element> > queue_t;
+
+    queue_t              _pending;
+    size_t               _numWritten;
+    mutable boost::mutex _outputMutex;
+};
+
+} // end namespace imdb
+
+#endif // BATCH_SEARCH_HPP
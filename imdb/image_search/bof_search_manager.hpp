@@ -12,10 +12,45 @@ the terms of the BSD license (see the LICENSE file).
 #include "inverted_index.hpp"
 #include "types.hpp"
 #include "filelist.hpp"
+#include "result_cursor.hpp"
+#include "result_cache.hpp"
+#include "reranker.hpp"
+
+#include <iosfwd>
+#include <boost/thread/mutex.hpp>
 
 namespace imdb {
 
 
+    /**
+     * @ingroup search
+     * @brief Accumulated effect of query term pruning over a number of queries.
+     */
+    struct pruning_report
+    {
+        pruning_report() : num_queries(0), num_terms(0), num_scanned_terms(0), num_postings(0), num_scanned_postings(0), num_recall_queries(0), recall_sum(0) {}
+
+        /// Adds the cost of a single query
+        void add(const query_cost& cost);
+
+        /// Adds the recall of a single query, i.e. the fraction of the exact top results also found with pruning
+        void add_recall(double recall);
+
+        pruning_report& operator+=(const pruning_report& other);
+
+        /// Prints the averages over all queries
+        void print(std::ostream& stream) const;
+
+        size_t   num_queries;
+        uint64_t num_terms;
+        uint64_t num_scanned_terms;
+        uint64_t num_postings;
+        uint64_t num_scanned_postings;
+        size_t   num_recall_queries;
+        double   recall_sum;
+    };
+
+
     /**
      * @ingroup search
      * @brief Standard bag-of features (Bof) search as used for searching images.
@@ -40,6 +75,29 @@ namespace imdb {
          * want to use the same function you used when constructing the InvertedIndex
          * - "idf": name of the idf_function used to weigh the query histogram, e.g. "video_google", you probably
          * want to use the same function you used when constructing the InvertedIndex
+         * - "max_resident_postings": [optional] if given, the index is loaded using InvertedIndex::load_tiered() and
+         * at most this many postings are kept in memory, all other posting lists are read from disk on demand
+         * - "hot_terms_file": [optional] text file with one term id per line, these terms are kept in memory with
+         * highest priority when using "max_resident_postings"
+         * - "prune_max_terms": [optional] only the posting lists of this many query terms with the highest tf-idf
+         * weights are scanned, see query_pruning
+         * - "prune_weight_mass": [optional] only the posting lists of the smallest set of highest weighted query
+         * terms that covers this fraction (e.g. 0.8) of the total query weight are scanned
+         * - "prune_recall_at": [optional] if given (e.g. 100) and pruning is enabled, each query is additionally run
+         * without pruning to measure the recall of the top "prune_recall_at" results, see pruning()
+         * - "numa": [optional] "replicate" places one copy of the posting lists on each NUMA node, queries then use
+         * the copy on the node of the calling thread (pin query threads using numa::pin_current_thread()). "interleave"
+         * spreads a single copy over all nodes. See InvertedIndex::place()
+         * - "large_pages": [optional] if true, posting and accumulator arrays are backed by large pages if possible
+         * - "cache_size_mb": [optional] if given, results of repeated queries are answered from a ResultCache
+         * using at most this many megabytes, see cache()
+         * - "rerank_file": [optional] property file of vec_f32_t descriptors of the indexed documents, e.g. the
+         * histograms written by compute_histvw. If given, the index only finds the best "rerank_candidates"
+         * documents, which are then re-scored by the distance of their descriptor to the query histogram, see Reranker
+         * - "rerank_distfn": [optional] distance function used for re-ranking, e.g. "l1norm" or "chi2", see
+         * distance_functions<T>.make(), default: "l2norm"
+         * - "rerank_candidates": [optional] number of candidates re-scored per query (at least the number of
+         * results), default: 1000
          */
         BofSearchManager(const ptree& parameters);
 
@@ -50,15 +108,84 @@ namespace imdb {
          * @param results A vector of dist_idx_t that holds the result indices in descending order of
          * similarity (i.e. best matches are first in the vector). Any potentially existing contents
          * of this vector are cleared before the new results are added.
+         * @param cost [optional] receives the terms/postings scanned and the time spent scoring and selecting
+         * the results, all 0 if the results were taken from the cache
+         * @param deadline [optional] stop scanning posting lists once this has passed, see query_pruning
+         * @return true if all query terms (left after pruning) have been scanned, false if the deadline stopped the scan
+         *
+         * With re-ranking ("rerank_file"), dist_idx_t.first holds the distance of the re-ranking stage
+         * and the results are in ascending order of distance.
+         */
+        bool query(const vec_f32_t& histvw, size_t num_results, vector<dist_idx_t>& results, query_cost* cost = 0,
+                   const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief Perform several queries at once, e.g. queries that arrived concurrently.
+         *
+         * Gives the same results as calling query() for each histogram, but traverses the posting list
+         * of a term shared by several queries only once, see InvertedIndex::query_batch().
+         * @param histvws Histograms of visual words of the queries
+         * @param num_results Desired number of results per query
+         * @param results results[q] receives the results of histvws[q], see query()
+         * @param costs [optional] costs[q] receives the cost of histvws[q], see query() and InvertedIndex::query_batch()
          */
-        void query(const vec_f32_t& histvw, size_t num_results, vector<dist_idx_t>& results) const;
+        void query_batch(const vector<vec_f32_t>& histvws, size_t num_results, vector<vector<dist_idx_t> >& results,
+                         vector<query_cost>* costs = 0) const;
+
+        /**
+         * @brief Perform a query whose results are fetched page by page.
+         *
+         * Scores all documents once and stores the candidate set in \p cursor, use ResultCursor::next()
+         * to retrieve the results, e.g. 50 at a time. Fetching further pages does not re-run the query.
+         * The candidates are ranked by the index only, "rerank_file" does not apply.
+         * @param histvw Histogram of visual words encoding the query 'document' (image)
+         * @param cursor Cursor that is reset to the candidates of this query
+         */
+        void query(const vec_f32_t& histvw, ResultCursor& cursor) const;
 
         const InvertedIndex& index() const {return _index;}
 
+        /// The index to be used by the calling thread, i.e. the replica on its NUMA node if replicated
+        const InvertedIndex& local_index() const;
+
+        /// Terms/postings scanned and recall (if "prune_recall_at" is given) of all queries run so far
+        pruning_report pruning() const;
+
+        /// Cache of query results, null unless "cache_size_mb" is given
+        const shared_ptr<ResultCache>& cache() const {return _cache;}
+
+        /// Second stage of the search, null unless "rerank_file" is given
+        const shared_ptr<Reranker>& reranker() const {return _reranker;}
+
     private:
 
+        // number of results requested from the index, more than num_results with re-ranking
+        size_t num_candidates(size_t num_results) const;
+
+        // second stage on the candidates of the index, if enabled
+        void rerank(const vec_f32_t& histvw, vector<dist_idx_t>& results, size_t num_results, query_cost& cost) const;
+
+        // adds the cost of a query to the pruning report and measures its recall if requested
+        void record_pruning(const InvertedIndex& index, const vec_f32_t& histvw, size_t num_results,
+                            const vector<dist_idx_t>& results, const query_cost& cost) const;
+
         InvertedIndex                   _index;
 
+        // _replicas[n] is the copy of _index placed on NUMA node n > 0,
+        // _index itself is placed on node 0. Empty unless "numa" is "replicate"
+        vector<shared_ptr<InvertedIndex> > _replicas;
+
+        query_pruning                   _pruning;
+        size_t                          _pruneRecallAt;
+
+        mutable pruning_report          _pruningReport;
+        mutable boost::mutex            _pruningMutex;
+
+        shared_ptr<ResultCache>         _cache;
+
+        shared_ptr<Reranker>            _reranker;
+        size_t                          _rerankCandidates;
+
         // tf*idf weighting functions
         shared_ptr<tf_function>  _tf;
         shared_ptr<idf_function> _idf;
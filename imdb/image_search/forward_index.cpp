@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "forward_index.hpp"
+
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+namespace imdb {
+
+ForwardIndex::ForwardIndex(const string& descriptor_file)
+    : _filename(descriptor_file)
+{
+    // the first reader also tells us the number of descriptors
+    shared_ptr<reader_t> reader(new reader_t(descriptor_file));
+    _size = static_cast<size_t>(reader->size());
+    _readers.push_back(reader);
+}
+
+
+void ForwardIndex::get(index_t document, vec_f32_t& descriptor) const
+{
+    if (document < 0 || static_cast<size_t>(document) >= _size)
+    {
+        throw std::runtime_error("ForwardIndex: document " + boost::lexical_cast<string>(document) + " out of range of " + _filename);
+    }
+
+    shared_ptr<reader_t> reader;
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (!_readers.empty())
+        {
+            reader = _readers.back();
+            _readers.pop_back();
+        }
+    }
+
+    // opening the file reads its offsets, so don't hold the lock meanwhile
+    if (!reader) reader.reset(new reader_t(_filename));
+
+    reader->get(descriptor, document);
+
+    boost::mutex::scoped_lock lock(_mutex);
+    _readers.push_back(reader);
+}
+
+} // end namespace imdb
@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef FORWARD_INDEX_HPP
+#define FORWARD_INDEX_HPP
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+#include "property_reader.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Maps a document of the searched collection to its stored descriptor.
+ *
+ * Used to answer "more like this document" queries without decoding its image and extracting its
+ * features again: the descriptor (e.g. the histogram of visual words written by compute_histvw that
+ * the inverted index was built from) is read on demand from a property file using the random access
+ * of PropertyReaderT. As a reader is not thread-safe, concurrent lookups each take a reader from a pool.
+ */
+class ForwardIndex : public boost::noncopyable
+{
+public:
+
+    /**
+     * @param descriptor_file Property file of vec_f32_t descriptors, one per document in the order of the
+     * searched collection
+     * @throw std::runtime_error if the file cannot be read
+     */
+    ForwardIndex(const string& descriptor_file);
+
+    /**
+     * @brief Reads the descriptor of a document.
+     * @throw std::runtime_error if \p document is out of range
+     */
+    void get(index_t document, vec_f32_t& descriptor) const;
+
+    /// Number of stored descriptors
+    size_t size() const {return _size;}
+
+private:
+
+    typedef PropertyReaderT<vec_f32_t> reader_t;
+
+    string                                      _filename;
+    size_t                                      _size;
+
+    // readers not used by any thread at the moment
+    mutable vector<shared_ptr<reader_t> >       _readers;
+    mutable boost::mutex                        _mutex;
+};
+
+} // end namespace imdb
+
+#endif // FORWARD_INDEX_HPP
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "fused_searcher.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "generator.hpp"
+
+namespace imdb {
+
+FusedSearcher::FusedSearcher(const ptree& parameters)
+{
+    _numCandidates = parameters.get<size_t>("candidates", 1000);
+
+    boost::optional<const ptree&> components = parameters.get_child_optional("components");
+    if (!components || components->empty()) throw std::runtime_error("fused search requires at least one component");
+
+    for (ptree::const_iterator it = components->begin(); it != components->end(); ++it)
+    {
+        const ptree& c = it->second;
+
+        // generator by name or by parameters
+        const ptree& generator = c.get_child("generator");
+        shared_ptr<Generator> gen = generator.empty() ? Generator::from_default_parameters(generator.data())
+                                                      : Generator::from_parameters(generator);
+
+        // search parameters inline or from a file
+        ptree search_params = c.get_child("search_params");
+        if (search_params.empty()) boost::property_tree::read_json(c.get<string>("search_params"), search_params);
+
+        component_t component;
+        component.weight = c.get<float>("weight", 1.0f);
+        std::cout << "FusedSearcher: component " << _components.size() << ", generator=" << gen->parameters().get<string>("name")
+                  << ", search_type=" << search_params.get<string>("search_type") << ", weight=" << component.weight << std::endl;
+
+        component.searcher.reset(new ImageSearcher(gen, search_params, c.get<string>("vocabulary", "")));
+
+        // scores are fused by document index, all components must search the same collection
+        if (!_components.empty() && component.searcher->num_documents() != _components[0].searcher->num_documents())
+        {
+            throw std::runtime_error("fused search component " + boost::lexical_cast<string>(_components.size()) + " searches "
+                                     + boost::lexical_cast<string>(component.searcher->num_documents()) + " documents, component 0 searches "
+                                     + boost::lexical_cast<string>(_components[0].searcher->num_documents()));
+        }
+        _components.push_back(component);
+    }
+}
+
+
+bool FusedSearcher::query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results, query_timings* timings,
+                          const Deadline& deadline) const
+{
+    const size_t numCandidates = std::max(num_results, _numCandidates);
+    vector<component_result> partial(_components.size());
+
+    // the component threads inherit the OpenMP setting of the caller, e.g. a single
+    // thread in a BatchSearch pool that already keeps all processors busy
+    int numOmpThreads = 0;
+#ifdef _OPENMP
+    numOmpThreads = omp_get_max_threads();
+#endif
+
+    // all but the first component get a thread of their own
+    boost::thread_group threads;
+    for (size_t i = 1; i < _components.size(); i++)
+    {
+        threads.add_thread(new boost::thread(boost::bind(&FusedSearcher::query_component, this, i, boost::cref(image),
+                                                         numCandidates, numOmpThreads, boost::cref(deadline), boost::ref(partial[i]))));
+    }
+    query_component(0, image, numCandidates, 0, deadline, partial[0]);
+    threads.join_all();
+
+    bool complete = true;
+    for (size_t i = 0; i < partial.size(); i++)
+    {
+        if (!partial[i].error.empty()) throw std::runtime_error(partial[i].error);
+        complete = complete && partial[i].complete;
+    }
+
+    Stopwatch watch;
+
+    // weighted sum of the normalized scores per image
+    std::map<index_t, float> fused;
+    for (size_t i = 0; i < partial.size(); i++)
+    {
+        const vector<dist_idx_t>& r = partial[i].results;
+        if (r.empty()) continue;
+
+        double lo = r[0].first, hi = r[0].first;
+        for (size_t j = 1; j < r.size(); j++)
+        {
+            lo = std::min(lo, r[j].first);
+            hi = std::max(hi, r[j].first);
+        }
+
+        const bool distances = _components[i].searcher->results_are_distances();
+        for (size_t j = 0; j < r.size(); j++)
+        {
+            double normalized = 1.0;
+            if (hi > lo) normalized = distances ? (hi - r[j].first) / (hi - lo) : (r[j].first - lo) / (hi - lo);
+            fused[r[j].second] += _components[i].weight * static_cast<float>(normalized);
+        }
+    }
+
+    results.clear();
+    results.reserve(fused.size());
+    for (std::map<index_t, float>::const_iterator it = fused.begin(); it != fused.end(); ++it)
+    {
+        results.push_back(dist_idx_t(it->second, it->first));
+    }
+
+    num_results = std::min(num_results, results.size());
+    std::partial_sort(results.begin(), results.begin() + num_results, results.end(), std::greater<dist_idx_t>());
+    results.resize(num_results);
+
+    if (timings)
+    {
+        // stages set by the caller (e.g. Decode) are kept
+        for (size_t i = 0; i < partial.size(); i++)
+        {
+            for (int s = 0; s < query_timings::NumStages; s++) timings->ms[s] = std::max(timings->ms[s], partial[i].timings.ms[s]);
+        }
+        timings->ms[query_timings::Select] += watch.elapsed_ms();
+    }
+    return complete;
+}
+
+
+void FusedSearcher::query_component(size_t i, const mat_8uc3_t& image, size_t num_candidates, int num_omp_threads, const Deadline& deadline,
+                                    component_result& result) const
+{
+#ifdef _OPENMP
+    if (num_omp_threads > 0) omp_set_num_threads(num_omp_threads);
+#endif
+
+    try {
+        result.complete = _components[i].searcher->query(image, num_candidates, result.results, &result.timings, deadline);
+    }
+    catch (const std::exception& e)
+    {
+        result.error = e.what();
+    }
+}
+
+} // end namespace imdb
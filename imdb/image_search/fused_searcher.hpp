@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef FUSED_SEARCHER_HPP
+#define FUSED_SEARCHER_HPP
+
+#include <boost/utility.hpp>
+
+#include "types.hpp"
+#include "image_searcher.hpp"
+#include "query_timings.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Late fusion of several query pipelines, e.g. a GALIF and a SHOG bag-of-features search.
+ *
+ * Each component is a complete ImageSearcher with its own generator, vocabulary and index. A query runs
+ * all components concurrently (each on its own thread, the first one on the calling thread), so the
+ * latency is that of the slowest component rather than the sum of all of them.
+ *
+ * The best candidates of each component are merged by weighted score normalization: the scores of a
+ * component are min-max normalized to [0,1] over its candidates (distances are flipped, such that 1 is
+ * always the best candidate), multiplied by the weight of the component and summed per image. An image
+ * not among the candidates of a component gets 0 from it. The fused results are in descending order
+ * of the fused score.
+ */
+class FusedSearcher : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Loads all components.
+     * @param parameters boost::property_tree with the following key/value pairs:
+     * - "components": array of components, each of which contains
+     *   - "generator": name of the generator (using its default parameters) or an object with its parameters
+     *   - "search_params": parameters of the search manager, see ImageSearcher, or the filename of a JSON file containing them
+     *   - "vocabulary": [optional] filename of the vocabulary, required for "BofSearch"
+     *   - "weight": [optional] weight of the component in the fused score, default: 1
+     * - "candidates": [optional] number of candidates taken from each component (at least the number of results), default: 1000
+     * @throw std::runtime_error if there are no components, a component cannot be loaded or the components
+     * do not search the same number of documents
+     */
+    FusedSearcher(const ptree& parameters);
+
+    /**
+     * @brief Runs all components on \p image and merges their results.
+     * @param image Query image
+     * @param num_results Desired number of results
+     * @param results Result indices into the searched collection in order of descending fused score
+     * @param timings [optional] receives the time spent in each stage, the maximum over all components
+     * as they run concurrently, merging is counted as Select
+     * @param deadline [optional] passed on to every component, see ImageSearcher::query()
+     * @return true if the results of all components are exact, false if any was truncated by the deadline
+     * @throw std::runtime_error if a component failed
+     */
+    bool query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results, query_timings* timings = 0,
+               const Deadline& deadline = Deadline()) const;
+
+    size_t num_components() const {return _components.size();}
+
+    const ImageSearcher& component(size_t i) const {return *_components[i].searcher;}
+
+private:
+
+    struct component_t
+    {
+        shared_ptr<ImageSearcher> searcher;
+        float                     weight;
+    };
+
+    // results of a single component within a query
+    struct component_result
+    {
+        component_result() : complete(false) {}
+
+        vector<dist_idx_t> results;
+        query_timings      timings;
+        string             error;
+        bool               complete;
+    };
+
+    // num_omp_threads > 0 sets the number of OpenMP threads of the calling thread first
+    void query_component(size_t i, const mat_8uc3_t& image, size_t num_candidates, int num_omp_threads, const Deadline& deadline,
+                         component_result& result) const;
+
+    vector<component_t> _components;
+    size_t              _numCandidates;
+};
+
+} // end namespace imdb
+
+#endif // FUSED_SEARCHER_HPP
@@ -7,6 +7,7 @@ the terms of the BSD license (see the LICENSE file).
 */
 #include <iostream>
 #include <vector>
+#include <stdexcept>
 
 #include <opencv2/imgproc/imgproc.hpp>
 //#include <opencv2/highgui/highgui.hpp>
@@ -102,6 +103,7 @@ galif_generator::galif_generator(const ptree& params)
     , _smoothHist         (parse<bool>  (_parameters, "generator.smooth_hist", true))
     , _normalizeHist      (parse<string>(_parameters, "generator.normalize_hist", "l2"))    // can be "lowe", "l2", or "none"
     , _samplerName        (parse<string>(_parameters, "generator.sampler.name", "grid"))
+    , _parallel           (parse<bool>  (_parameters, "generator.parallel", false))     // extract the features of a single image using all processors (OpenMP)
     , _sampler            (ImageSampler::create(_samplerName))
 {
 
@@ -130,6 +132,7 @@ galif_generator::galif_generator(const ptree& params)
     std::cout << " generator.smooth_hist=" << _smoothHist << std::endl;
     std::cout << " generator.normalize_hist=" << _normalizeHist << std::endl;
     std::cout << " generator.sampler.name=" << _samplerName << std::endl;
+    std::cout << " generator.parallel=" << _parallel << std::endl;
 
     for (uint i = 0; i < _numOrients; i++)
     {
@@ -295,9 +298,11 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
     cv::Mat_<std::complex<double> > src_ft(_filterSize);
     cv::dft(src, src_ft);
 
-    // apply each filter
-    std::vector<cv::Mat> responses;
-    for (uint i = 0; i < _numOrients; i++)
+    // apply each filter, the orientations are independent of each other
+    const int numOrients = static_cast<int>(_numOrients);
+    std::vector<cv::Mat> responses(_numOrients);
+    #pragma omp parallel for if (_parallel)
+    for (int i = 0; i < numOrients; i++)
     {
         // convolve in frequency domain (i.e. multiply spectrums)
         cv::Mat_<std::complex<double> > dst_ft(_filterSize);
@@ -322,7 +327,7 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
 
         //cv::imwrite("mag.png", mag*255);
 
-        responses.push_back(mag);
+        responses[i] = mag;
     }
 
     // local region size is relative to image size
@@ -337,7 +342,8 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
     int tileSize = featureSize / _tiles;
     float halfTileSize = (float) tileSize / 2;
 
-    for (size_t i = 0; i < _numOrients; i++)
+    #pragma omp parallel for if (_parallel)
+    for (int i = 0; i < numOrients; i++)
     {
         // copy response image centered into a new, larger image that contains an empty border
         // of size tileSize around all sides. This additional  border is essential to be able to
@@ -372,8 +378,20 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
     // as the keypoints and features vector
     emptyFeatures.resize(keypoints.size(), 0);
 
+    // each keypoint writes its own entry, so the features are in the
+    // same order for any number of threads
+    features.resize(keypoints.size());
+
+    // checked up front, exceptions must not leave the parallel loop below
+    if (_normalizeHist != "l2" && _normalizeHist != "lowe" && _normalizeHist != "none")
+    {
+        throw std::runtime_error("unsupported histogram normalization method passed (" + _normalizeHist + ")." + "Allowed methods are : lowe, l2, none." );
+    }
+
     // collect filter responses for each keypoint/region
-    for (size_t i = 0; i < keypoints.size(); i++)
+    const int numKeypoints = static_cast<int>(keypoints.size());
+    #pragma omp parallel for schedule(dynamic, 16) if (_parallel)
+    for (int i = 0; i < numKeypoints; i++)
     {
         const vec_f32_t& keypoint = keypoints[i];
 
@@ -400,7 +418,7 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
             // skip this patch. It contains no strokes.
             // add empty histogram, filled with zeros,
             // will be (optionally) filtered in a later descriptor computation step
-            features.push_back(histogram);
+            features[i] = histogram;
             emptyFeatures[i] = 1;
             continue;
         }
@@ -457,11 +475,8 @@ void galif_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoin
         // do not normalize if user has explicitly asked for that
         else if (_normalizeHist == "none") {}
 
-        // let the user know about the wrong parameter
-        else throw std::runtime_error("unsupported histogram normalization method passed (" + _normalizeHist + ")." + "Allowed methods are : lowe, l2, none." );
-
         // add histogram to the set of local features for that image
-        features.push_back(histogram);
+        features[i] = histogram;
     }
 
 
@@ -97,6 +97,25 @@ private:
 };
 
 
+// Regular grid over the bounding box of the strokes (non-white pixels) of a
+// sketch, keeping only the points whose grid cell contains a stroke. Unlike
+// the grid sampler no samples are spent on the empty background (whose features
+// are discarded by the generators anyway), so far fewer samples give the same
+// coverage of the sketch, e.g. for cheaper queries
+class stroke_sampler : public ImageSampler
+{
+public:
+
+    virtual ~stroke_sampler() {}
+    void setParameters(ptree &params);
+    void sample(vec_vec_f32_t& samples, const cv::Mat &image) const;
+
+private:
+
+    uint _numSamples;
+};
+
+
 } // end namespace
 
 #endif // IMAGE_SAMPLER_H
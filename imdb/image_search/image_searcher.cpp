@@ -0,0 +1,359 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "image_searcher.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <cassert>
+#include <cmath>
+
+#include "property_reader.hpp"
+#include "quantizer.hpp"
+#include "linear_search.hpp"
+#include "distance.hpp"
+
+namespace imdb {
+
+namespace {
+
+// quantizes the samples in interleaved passes until the deadline has passed or, if tolerance > 0, until
+// the histogram of visual words has stabilized, i.e. a pass changed the L1 normalized histogram by less
+// than tolerance. Returns false if the deadline stopped the quantization.
+bool quantize_progressive(const vec_vec_f32_t& samples, const vec_vec_f32_t& vocabulary, vec_vec_f32_t& quantized_samples,
+                          quantize_fn& quantizer, const Deadline& deadline, float tolerance)
+{
+    // pass p quantizes the samples p, p + num_passes, p + 2*num_passes, ... such that the
+    // samples quantized before stopping are spread evenly over the whole image
+    const size_t num_passes = 8;
+
+    // unnormalized histogram of the samples quantized so far
+    vec_f32_t histogram(vocabulary.size(), 0.0f);
+    double mass = 0;
+
+    quantized_samples.clear();
+    for (size_t pass = 0; pass < num_passes; pass++)
+    {
+        // at least one pass, otherwise there would be nothing to search for
+        if (pass > 0 && deadline.expired()) return false;
+
+        vec_vec_f32_t part, quantized;
+        for (size_t i = pass; i < samples.size(); i += num_passes) part.push_back(samples[i]);
+        quantize_samples_parallel(part, vocabulary, quantized, quantizer);
+        quantized_samples.insert(quantized_samples.end(), quantized.begin(), quantized.end());
+
+        if (tolerance <= 0) continue;
+
+        vec_f32_t previous = histogram;
+        double previousMass = mass;
+        for (size_t i = 0; i < quantized.size(); i++)
+        {
+            for (size_t j = 0; j < histogram.size(); j++)
+            {
+                histogram[j] += quantized[i][j];
+                mass += quantized[i][j];
+            }
+        }
+
+        if (pass == 0 || previousMass <= 0 || mass <= 0) continue;
+
+        double change = 0;
+        for (size_t j = 0; j < histogram.size(); j++) change += std::abs(histogram[j] / mass - previous[j] / previousMass);
+        if (change < tolerance) break;
+    }
+    return true;
+}
+
+} // end anonymous namespace
+
+
+ImageSearcher::ImageSearcher(shared_ptr<Generator> generator, const ptree& search_params, const string& vocabulary_file)
+    : _generator(generator)
+    , _samplingTolerance(0)
+    , _tensor(false)
+{
+    string search_type = search_params.get<string>("search_type");
+
+    if (search_type == "BofSearch")
+    {
+        if (vocabulary_file.empty()) throw std::runtime_error("bag-of-features search requires a vocabulary");
+
+        read_property(_vocabulary, vocabulary_file);
+        _bofSearch.reset(new BofSearchManager(search_params));
+
+        _samplingTolerance = search_params.get<float>("sampling_tolerance", 0.0f);
+        if (_samplingTolerance > 0) std::cout << "ImageSearcher: adaptive sampling, tolerance=" << _samplingTolerance << std::endl;
+
+        // stored histograms for queries by document, usually the same file the re-ranking reads
+        const string histvw_file = search_params.get<string>("histvw_file", search_params.get<string>("rerank_file", ""));
+        if (!histvw_file.empty())
+        {
+            _forwardIndex.reset(new ForwardIndex(histvw_file));
+
+            // the stored histograms are passed to the index as they are, they must match it
+            if (_forwardIndex->size() != _bofSearch->index().num_documents())
+            {
+                throw std::runtime_error("histvw file " + histvw_file + " does not contain a histogram per indexed document");
+            }
+            if (_forwardIndex->size() > 0)
+            {
+                vec_f32_t first;
+                _forwardIndex->get(0, first);
+                if (first.size() != _vocabulary.size())
+                {
+                    throw std::runtime_error("histvw file " + histvw_file + " does not contain histograms over the vocabulary " + vocabulary_file);
+                }
+            }
+            std::cout << "ImageSearcher: queries by document use the histograms in " << histvw_file << std::endl;
+        }
+    }
+    else if (search_type == "LinearSearch")
+    {
+        // Tensor descriptor is a bit of a special case as we additionally
+        // need to pass a 'mask' to the distance function, so we replicate
+        // most of the functionality implemented in LinearSearchManager
+        if (_generator->parameters().get<string>("name") == "tensor")
+        {
+            _tensor = true;
+            read_property(_tensorFeatures, search_params.get<string>("descriptor_file"));
+        }
+        else
+        {
+            _linearSearch.reset(new LinearSearchManager(search_params));
+        }
+    }
+    else
+    {
+        throw std::runtime_error("unsupported search type " + search_type);
+    }
+}
+
+
+bool ImageSearcher::compute_histvw(const mat_8uc3_t& image, vec_f32_t& histvw, query_timings* timings, const Deadline& deadline) const
+{
+    assert(_bofSearch);
+
+    Stopwatch watch;
+
+    anymap_t data;
+    data["image"] = image;
+    _generator->compute(data);
+
+    if (timings) timings->ms[query_timings::Compute] = watch.restart_ms();
+
+    // quantize
+    quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
+    vec_vec_f32_t quantized_samples;
+
+    const vec_vec_f32_t& samples = boost::any_cast<vec_vec_f32_t>(data["features"]);
+    bool complete = true;
+    if (deadline.limited() || _samplingTolerance > 0)
+    {
+        complete = quantize_progressive(samples, _vocabulary, quantized_samples, quantizer, deadline, _samplingTolerance);
+    }
+    else quantize_samples_parallel(samples, _vocabulary, quantized_samples, quantizer);
+
+    if (timings) timings->ms[query_timings::Quantize] = watch.restart_ms();
+
+    build_histvw(quantized_samples, _vocabulary.size(), histvw, false);
+
+    // if quantization stopped early, scale the histogram to the mass of all samples, such that
+    // it stays comparable by raw distances to full histograms, e.g. those of the "rerank_file"
+    if (!quantized_samples.empty() && quantized_samples.size() < samples.size())
+    {
+        const float scale = static_cast<float>(samples.size()) / static_cast<float>(quantized_samples.size());
+        for (size_t i = 0; i < histvw.size(); i++) histvw[i] *= scale;
+    }
+
+    if (timings) timings->ms[query_timings::Histogram] = watch.restart_ms();
+    return complete;
+}
+
+
+bool ImageSearcher::query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results, query_timings* timings,
+                          const Deadline& deadline) const
+{
+    if (_bofSearch)
+    {
+        vec_f32_t histvw;
+        bool complete = compute_histvw(image, histvw, timings, deadline);
+
+        query_cost cost;
+        complete = _bofSearch->query(histvw, num_results, results, &cost, deadline) && complete;
+
+        if (timings)
+        {
+            timings->ms[query_timings::Score] = cost.score_ms;
+            timings->ms[query_timings::Select] = cost.select_ms + cost.rerank_ms;
+        }
+        return complete;
+    }
+
+    Stopwatch watch;
+
+    anymap_t data;
+    data["image"] = image;
+    _generator->compute(data);
+
+    if (timings) timings->ms[query_timings::Compute] = watch.restart_ms();
+
+    bool complete = search_linear(data, num_results, results, deadline);
+
+    if (timings) timings->ms[query_timings::Score] = watch.restart_ms();
+    return complete;
+}
+
+
+bool ImageSearcher::query_document(index_t document, size_t num_results, vector<dist_idx_t>& results, query_timings* timings,
+                                   const Deadline& deadline) const
+{
+    if (!supports_document_queries())
+    {
+        throw std::runtime_error("queries by document require the parameter histvw_file (or linear search)");
+    }
+
+    Stopwatch watch;
+
+    if (_bofSearch)
+    {
+        vec_f32_t histvw;
+        _forwardIndex->get(document, histvw);
+        if (histvw.size() != _vocabulary.size()) throw std::runtime_error("the stored histogram of the document does not match the vocabulary");
+        if (timings) timings->ms[query_timings::Compute] = watch.restart_ms();
+
+        query_cost cost;
+        bool complete = _bofSearch->query(histvw, num_results, results, &cost, deadline);
+
+        if (timings)
+        {
+            timings->ms[query_timings::Score] = cost.score_ms;
+            timings->ms[query_timings::Select] = cost.select_ms + cost.rerank_ms;
+        }
+        return complete;
+    }
+
+    vec_f32_t descr;
+    _linearSearch->feature(document, descr);
+    if (timings) timings->ms[query_timings::Compute] = watch.restart_ms();
+
+    bool complete = _linearSearch->query(descr, num_results, results, deadline);
+
+    if (timings) timings->ms[query_timings::Score] = watch.restart_ms();
+    return complete;
+}
+
+
+void ImageSearcher::query_batch(const vector<mat_8uc3_t>& images, size_t num_results, vector<vector<dist_idx_t> >& results, vector<string>& errors) const
+{
+    const int numImages = static_cast<int>(images.size());
+    results.assign(numImages, vector<dist_idx_t>());
+    errors.assign(numImages, string());
+
+    // feature extraction is independent per image
+    vector<anymap_t> data(numImages);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < numImages; i++)
+    {
+        try {
+            data[i]["image"] = images[i];
+            _generator->compute(data[i]);
+        }
+        catch (const std::exception& e)
+        {
+            errors[i] = e.what();
+        }
+    }
+
+    if (!_bofSearch)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < numImages; i++)
+        {
+            if (!errors[i].empty()) continue;
+
+            try {
+                search_linear(data[i], num_results, results[i]);
+            }
+            catch (const std::exception& e)
+            {
+                errors[i] = e.what();
+            }
+        }
+        return;
+    }
+
+    // quantize the samples of all images in a single pass over the vocabulary,
+    // samples[offsets[i], offsets[i+1]) are the samples of image i
+    vec_vec_f32_t samples;
+    vector<size_t> offsets(numImages + 1, 0);
+    for (int i = 0; i < numImages; i++)
+    {
+        if (errors[i].empty())
+        {
+            const vec_vec_f32_t& features = boost::any_cast<vec_vec_f32_t>(data[i]["features"]);
+            samples.insert(samples.end(), features.begin(), features.end());
+            data[i].clear();
+        }
+        offsets[i + 1] = samples.size();
+    }
+
+    quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
+    vec_vec_f32_t quantized_samples;
+    quantize_samples_parallel(samples, _vocabulary, quantized_samples, quantizer);
+
+    vector<vec_f32_t> histvws;
+    vector<int> queries;
+    for (int i = 0; i < numImages; i++)
+    {
+        if (!errors[i].empty()) continue;
+
+        vec_vec_f32_t quantized(offsets[i + 1] - offsets[i]);
+        for (size_t j = 0; j < quantized.size(); j++) quantized[j].swap(quantized_samples[offsets[i] + j]);
+
+        histvws.push_back(vec_f32_t());
+        build_histvw(quantized, _vocabulary.size(), histvws.back(), false);
+        queries.push_back(i);
+    }
+
+    vector<vector<dist_idx_t> > batchResults;
+    _bofSearch->query_batch(histvws, num_results, batchResults);
+    for (size_t k = 0; k < queries.size(); k++) results[queries[k]].swap(batchResults[k]);
+}
+
+
+size_t ImageSearcher::num_documents() const
+{
+    if (_bofSearch) return _bofSearch->index().num_documents();
+    if (_linearSearch) return _linearSearch->size();
+    return _tensorFeatures.size();
+}
+
+
+shared_ptr<ResultCache> ImageSearcher::cache() const
+{
+    if (_bofSearch) return _bofSearch->cache();
+    if (_linearSearch) return _linearSearch->cache();
+    return shared_ptr<ResultCache>();
+}
+
+
+bool ImageSearcher::search_linear(anymap_t& data, size_t num_results, vector<dist_idx_t>& results, const Deadline& deadline) const
+{
+    const vec_f32_t& descr = get<vec_f32_t>(data, "features");
+
+    if (_tensor)
+    {
+        const vector<bool>& mask = get<vector<bool> >(data, "mask");
+        dist_frobenius<vec_f32_t> distfn;
+        distfn.mask = &mask;
+        return linear_search(descr, _tensorFeatures, results, std::min(num_results, _tensorFeatures.size()), distfn, deadline);
+    }
+    return _linearSearch->query(descr, num_results, results, deadline);
+}
+
+} // end namespace imdb
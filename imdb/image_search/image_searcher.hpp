@@ -0,0 +1,149 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef IMAGE_SEARCHER_HPP
+#define IMAGE_SEARCHER_HPP
+
+#include <boost/utility.hpp>
+
+#include "types.hpp"
+#include "generator.hpp"
+#include "bof_search_manager.hpp"
+#include "linear_search_manager.hpp"
+#include "query_timings.hpp"
+#include "deadline.hpp"
+#include "forward_index.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Complete query pipeline from an image to a list of results.
+ *
+ * Bundles the Generator used for extracting the features of a query image with the search manager
+ * (and for bag-of-features search the vocabulary used for quantizing the features). All of these are
+ * loaded once in the constructor, such that a batch of queries or a long running server only pays for
+ * the feature extraction and the actual search per query.
+ *
+ * query() is const and can be called concurrently from several threads.
+ */
+class ImageSearcher : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Loads all datastructures required to answer a query.
+     * @param generator Generator used for extracting the features of a query image
+     * @param search_params Parameters of the search manager, "search_type" must be either "BofSearch" (see
+     * BofSearchManager for further parameters) or "LinearSearch" (see LinearSearchManager). For "BofSearch",
+     * "sampling_tolerance" > 0 enables adaptive sampling: the samples of a query are quantized in interleaved
+     * passes of 1/8 of the samples each, and quantization stops once a pass changes the L1 normalized histogram of
+     * visual words by less than this tolerance (e.g. 0.1), default: 0 (all samples are quantized). The histogram
+     * of a query quantized only in part is scaled to the number of all its samples. "histvw_file"
+     * optionally names the property file of the histograms of visual words of the searched collection (by default
+     * the "rerank_file", if any), which enables query_document()
+     * @param vocabulary_file Filename of the vocabulary used for quantization, only required for "BofSearch"
+     * @throw std::runtime_error if the search type is not supported, the vocabulary is missing or the
+     * "histvw_file" does not match the index and vocabulary
+     */
+    ImageSearcher(shared_ptr<Generator> generator, const ptree& search_params, const string& vocabulary_file = "");
+
+    /**
+     * @brief Extracts the features of \p image and searches for the most similar images.
+     * @param image Query image
+     * @param num_results Desired number of results
+     * @param results Result indices into the searched collection in order of descending similarity
+     * @param timings [optional] receives the time spent in each stage of the query (Compute to Select)
+     * @param deadline [optional] once this has passed, the remaining stages degrade gracefully: only part of the
+     * samples is quantized, only the posting lists of the highest weighted terms are scanned (bag-of-features
+     * search) or only part of the features is compared (linear search). Feature extraction always runs completely.
+     * @return true if the results are exact, false if they were truncated by the deadline
+     */
+    bool query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results, query_timings* timings = 0,
+               const Deadline& deadline = Deadline()) const;
+
+    /**
+     * @brief Searches for the images most similar to a document of the searched collection.
+     *
+     * Instead of decoding its image and extracting its features, the stored descriptor of the document is
+     * used: its histogram of visual words from "histvw_file" (bag-of-features search) or its feature loaded by
+     * the LinearSearchManager. The document itself is part of the results, typically as the best one.
+     * @param document Index of the document in the searched collection
+     * @param num_results Desired number of results
+     * @param results Result indices into the searched collection in order of descending similarity
+     * @param timings [optional] receives the time spent in each stage, reading the stored descriptor is counted as Compute
+     * @param deadline [optional] see query()
+     * @return true if the results are exact, false if they were truncated by the deadline
+     * @throw std::runtime_error if there are no stored descriptors (see supports_document_queries()) or
+     * \p document is out of range
+     */
+    bool query_document(index_t document, size_t num_results, vector<dist_idx_t>& results, query_timings* timings = 0,
+                        const Deadline& deadline = Deadline()) const;
+
+    /// True if query_document() can be used
+    bool supports_document_queries() const {return _forwardIndex || _linearSearch;}
+
+    /**
+     * @brief Answers several queries at once, e.g. queries that arrived concurrently at a server.
+     *
+     * The features of all images are extracted in parallel. For bag-of-features search the samples of
+     * all images are then quantized in one pass and the index is scored for all histograms together,
+     * see BofSearchManager::query_batch(). The results are identical to calling query() per image
+     * without a deadline and without adaptive sampling.
+     * @param images Query images
+     * @param num_results Desired number of results per query
+     * @param results results[i] receives the results of images[i]
+     * @param errors errors[i] is the reason if the features of images[i] could not be extracted, empty otherwise
+     */
+    void query_batch(const vector<mat_8uc3_t>& images, size_t num_results, vector<vector<dist_idx_t> >& results, vector<string>& errors) const;
+
+    /**
+     * @brief Computes the histogram of visual words of an image, only valid for bag-of-features search
+     * @return true if all samples have been quantized, false if the deadline stopped the quantization
+     * and the histogram was built from an evenly spread subset of the samples (scaled to all samples)
+     */
+    bool compute_histvw(const mat_8uc3_t& image, vec_f32_t& histvw, query_timings* timings = 0, const Deadline& deadline = Deadline()) const;
+
+    /// The bag-of-features search manager, null for linear search
+    const shared_ptr<BofSearchManager>& bof_search() const { return _bofSearch; }
+
+    /// Number of documents searched, i.e. results are in [0, num_documents()-1]
+    size_t num_documents() const;
+
+    /// True if dist_idx_t.first of the results is a distance (smaller is better), false if it is a similarity score
+    bool results_are_distances() const { return !_bofSearch || _bofSearch->reranker(); }
+
+    /// Result cache of the search manager, null if not enabled by "cache_size_mb" (or for tensor descriptors)
+    shared_ptr<ResultCache> cache() const;
+
+    const Generator& generator() const { return *_generator; }
+
+private:
+
+    // searches the features computed by the generator using linear search,
+    // returns false if the deadline stopped the search
+    bool search_linear(anymap_t& data, size_t num_results, vector<dist_idx_t>& results, const Deadline& deadline = Deadline()) const;
+
+    shared_ptr<Generator>           _generator;
+
+    // bag-of-features search
+    vec_vec_f32_t                   _vocabulary;
+    shared_ptr<BofSearchManager>    _bofSearch;
+    float                           _samplingTolerance;
+    shared_ptr<ForwardIndex>        _forwardIndex;
+
+    // linear search, tensor descriptors are searched directly
+    // as they additionally need the mask of the query
+    shared_ptr<LinearSearchManager> _linearSearch;
+    vec_vec_f32_t                   _tensorFeatures;
+    bool                            _tensor;
+};
+
+} // end namespace imdb
+
+#endif // IMAGE_SEARCHER_HPP
@@ -14,6 +14,7 @@ the terms of the BSD license (see the LICENSE file).
 #include <set>
 
 #include "types.hpp"
+#include "deadline.hpp"
 
 
 /**
@@ -31,9 +32,14 @@ the terms of the BSD license (see the LICENSE file).
  * The result is always a container class containing at each index
  * a std::pair(distance, index), where index points into the features
  * collection.
+ *
+ * If a \p deadline is given and passes before all features have been compared, the search
+ * stops and the result contains the best matches among the features compared so far.
+ * Returns false in that case, true if all features have been compared.
  */
 template <class storage_t, class result_t, class distfn_t>
-void linear_search(const typename storage_t::value_type& query_feature, const storage_t& features, result_t& result, size_t num_results, const distfn_t& distfn)
+bool linear_search(const typename storage_t::value_type& query_feature, const storage_t& features, result_t& result, size_t num_results, const distfn_t& distfn,
+                   const imdb::Deadline& deadline = imdb::Deadline())
 {
 
     using namespace std;
@@ -42,8 +48,16 @@ void linear_search(const typename storage_t::value_type& query_feature, const st
     // i.e. result will be updated
     if (result.size() > 0) make_heap(result.begin(), result.end());
 
+    bool complete = true;
     for (size_t i = 0; i < features.size(); i++)
     {
+        // reading the clock is cheap compared to a few hundred distances
+        if ((i & 255) == 255 && deadline.expired())
+        {
+            complete = false;
+            break;
+        }
+
         typename distfn_t::result_type dist = distfn(query_feature, features[i]);
 
         // if the number of wanted elements is not reached, every element is taken
@@ -64,6 +78,7 @@ void linear_search(const typename storage_t::value_type& query_feature, const st
 
     // make an ascending sorted list out of the heap
     sort_heap(result.begin(), result.end());
+    return complete;
 }
 
 #endif // SEARCH_HPP
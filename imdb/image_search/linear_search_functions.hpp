@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef LINEAR_SEARCH_FUNCTIONS_HPP
+#define LINEAR_SEARCH_FUNCTIONS_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+
+#include "types.hpp"
+#include "distance.hpp"
+#include "deadline.hpp"
+#include "linear_search.hpp"
+
+namespace imdb
+{
+
+/**
+ * @ingroup search
+ * @brief linear_search() instantiated for a distance functor known at compile time.
+ *
+ * The functor is default constructed, i.e. it must not require any state.
+ */
+template <class distfn_t, class storage_t>
+bool linear_search_with(const typename storage_t::value_type& query_feature, const storage_t& features, vector<dist_idx_t>& result,
+                        size_t num_results, const Deadline& deadline)
+{
+    return linear_search(query_feature, features, result, num_results, distfn_t(), deadline);
+}
+
+
+/**
+ * @ingroup search
+ * @brief Factory that generates a complete linear search loop from the name of a distance function.
+ *
+ * A linear_search() with a distance function from distance_functions<T>.make() pays an indirect call
+ * through the boost::function for every feature compared, such that the compiler can neither inline
+ * nor vectorize the distance computation. This factory resolves the name once and returns a
+ * linear_search() instantiated for the concrete functor from distance.hpp, the boost::function is
+ * then only called once per query.
+ *
+ * The names are the same as for distance_functions<T>.make(), except for "frobenius" which needs a
+ * mask per query and is therefore not available.
+ */
+template <class storage_t>
+struct linear_search_functions
+{
+    typedef typename storage_t::value_type T;
+    typedef boost::function<bool (const T&, const storage_t&, vector<dist_idx_t>&, size_t, const Deadline&)> searchfn_t;
+
+    searchfn_t make(const std::string& name)
+    {
+        if (name == "l1norm") return &linear_search_with<l1norm<T>, storage_t>;
+        if (name == "l2norm") return &linear_search_with<l2norm<T>, storage_t>;
+        if (name == "l2norm_squared") return &linear_search_with<l2norm_squared<T>, storage_t>;
+        if (name == "jsd") return &linear_search_with<jsd<T>, storage_t>;
+        if (name == "chi2") return &linear_search_with<chi2<T>, storage_t>;
+        if (name == "one_minus_dot") return &linear_search_with<one_minus_dot<T>, storage_t>;
+        if (name == "df") return &linear_search_with<dist_df<T>, storage_t>;
+
+        return searchfn_t();
+    }
+};
+
+} // namespace imdb
+
+#endif // LINEAR_SEARCH_FUNCTIONS_HPP
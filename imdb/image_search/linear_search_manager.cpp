@@ -8,36 +8,80 @@ the terms of the BSD license (see the LICENSE file).
 
 #include <algorithm>
 
+#include <boost/lexical_cast.hpp>
+
 #include "linear_search_manager.hpp"
-#include "linear_search.hpp"
 #include "property_reader.hpp"
 
 namespace imdb
 {
 
 LinearSearchManager::LinearSearchManager(const ptree& parameters)
+    : _metric(FeatureMatrix::L2Norm)
+    , _numThreads(parameters.get<int>("num_threads", 0))
 {
     string filename = parameters.get<string>("descriptor_file");
     string distfn_str = parameters.get<string>("distfn");
 
-    // try to create distance function object
-    _distfn = distance_functions<vec_f32_t>().make(distfn_str);
-    if (!_distfn) throw std::runtime_error("unknown distance function: " + distfn_str);
+    // resolve the distance function once, the search loop is then specific to it
+    _search = linear_search_functions<vec_vec_f32_t>().make(distfn_str);
+    if (!_search) throw std::runtime_error("unknown distance function: " + distfn_str);
 
     // try to load features
     try {
-        read_property(_features, filename);
+        if (FeatureMatrix::metric_from_name(distfn_str, _metric))
+        {
+            _matrix.reset(new FeatureMatrix(filename));
+            std::cout << "LinearSearchManager: " << _matrix->rows() << " features of " << _matrix->dims() << " dimensions in a feature matrix" << std::endl;
+        }
+        else
+        {
+            read_property(_features, filename);
+        }
     } catch(std::exception& e) {
         std::cerr << "LinearSearchManager: exception occured when trying to load features file: " + filename << std::endl;
         std::cerr << e.what() << std::endl;
     }
+
+    boost::optional<double> cache_size_mb = parameters.get_optional<double>("cache_size_mb");
+    if (cache_size_mb)
+    {
+        std::cout << "LinearSearchManager: result cache, cache_size_mb=" << *cache_size_mb << std::endl;
+        _cache.reset(new ResultCache(static_cast<size_t>(*cache_size_mb * 1024 * 1024)));
+    }
 }
 
 
-void LinearSearchManager::query(const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& result) const
+bool LinearSearchManager::query(const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& result, const Deadline& deadline) const
 {
-    size_t max_num_results = std::min(num_results, _features.size());
-    linear_search(descr, _features, result, max_num_results, _distfn);
+    if (_cache && _cache->lookup(descr, num_results, result)) return true;
+
+    bool complete;
+    if (_matrix)
+    {
+        complete = _matrix->search(descr, _metric, num_results, result, _numThreads, deadline);
+    }
+    else
+    {
+        size_t max_num_results = std::min(num_results, _features.size());
+        complete = _search(descr, _features, result, max_num_results, deadline);
+    }
+
+    // results of a partial scan must not be served to later queries
+    if (_cache && complete) _cache->insert(descr, num_results, result);
+    return complete;
+}
+
+
+void LinearSearchManager::feature(index_t index, vec_f32_t& descr) const
+{
+    if (index < 0 || static_cast<size_t>(index) >= size())
+    {
+        throw std::runtime_error("LinearSearchManager: feature " + boost::lexical_cast<string>(index) + " out of range");
+    }
+
+    if (_matrix) _matrix->get(static_cast<size_t>(index), descr);
+    else descr = _features[index];
 }
 
 } // namespace imdb
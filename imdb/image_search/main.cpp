@@ -14,6 +14,9 @@ the terms of the BSD license (see the LICENSE file).
 #include <io.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+
+#include <QTime>
 
 #include <opencv2/highgui/highgui.hpp>
 
@@ -28,10 +31,11 @@ the terms of the BSD license (see the LICENSE file).
 //descriptors/
 #include <generator.hpp>
 //search/
-#include <linear_search.hpp>
-#include <bof_search_manager.hpp>
-#include <linear_search_manager.hpp>
-#include <distance.hpp>
+#include <image_searcher.hpp>
+#include <batch_search.hpp>
+#include <fused_searcher.hpp>
+#include <result_file.hpp>
+#include <search_server.hpp>
 //myIO/
 //#include "myIO.h"
 
@@ -41,82 +45,37 @@ the terms of the BSD license (see the LICENSE file).
 
 using namespace imdb;
 
-template <class search_t>
-void image_search(const anymap_t& data, const search_t& search, size_t num_results, vector<dist_idx_t>& results)
-{
-    typedef typename search_t::descr_t descr_t;
-    descr_t descr = get<descr_t>(data, "features");
-    search.query(descr, num_results, results);
-}
-
-
-
-class command_search : public Command
+// options shared by the batch search and the search server, i.e.
+// everything needed to construct an ImageSearcher
+class command_searcher : public Command
 {
 public:
 
-    command_search()
-        : Command("image_search [options]")
-        , _co_query_image("queryimage"        , "q", "filename of images filelist to be used as the query [required]")
+    command_searcher(const std::string& usage)
+        : Command(usage)
         , _co_search_ptree("searchptree"      , "s", "filename of the JSON file containing parameters for the search manager [optional, if not provided, --searchparams must be given]")
         , _co_search_params("searchparams"    , "m", "parameters for the search manager [optional, if not provided, --searchptree must be given]")
         , _co_vocabulary("vocabulary"         , "v", "filename of vocabulary used for quantization [optional, only required with bag-of-features search]")
         , _co_filelist("filelist"             , "l", "filename of images filelist [required]")
         , _co_generator_name("generatorname"  , "g", "name of generator [optional, if given, we will use generator's default parameters and ignore --generatorptree]")
         , _co_generator_ptree("generatorptree", "p", "filename of the JSON file containing generator name and parameters [optional, if not provided, generator's default values are used']")
-        , _co_num_results  ("numresults"      , "n", "number of results to search for [optional, if not provided all distances get computed]")
-		, _co_wkdir("working dir"             , "r", "directory path of the query [required]")
-		, _co_outdir("saving dir"             , "o", "the path of the retrieval list saved in [optional, if not provided, will be set as \"retrieval_list\"]")
+        , _co_query_generator("querygenerator", "Q", "generator parameters overriding those of --generatorname/--generatorptree for the queries only, e.g. sampler.name=stroke sampler.num_samples=200 [optional]")
     {
-        add(_co_query_image);
         add(_co_search_ptree);
         add(_co_search_params);
         add(_co_vocabulary);
         add(_co_filelist);
         add(_co_generator_ptree);
-        add(_co_num_results);
         add(_co_generator_name);
-		add(_co_wkdir);
-		add(_co_outdir);
+        add(_co_query_generator);
     }
 
+protected:
 
-    bool run(const std::vector<std::string>& args)
+    // either searchptree or searchparams must be given
+    bool parse_search_params(const std::vector<std::string>& args, ptree& search_params)
     {
-        if (args.size() == 0)
-        {
-            print();
-            return false;
-        }
-
-        warn_for_unknown_option(args);
-
-
-        string in_queryimage;
         string in_searchptree;
-        string in_filelist;
-        string in_generatorptree;
-        string in_generatorname;
-        string in_vocabulary;
-		string in_wkdir;
-		string in_outdir;
-
-        // this default value will make the search managers search
-        // for all images if the user does not provide a value
-        size_t in_numresults = std::numeric_limits<size_t>::max();
-
-
-        // check that the required options are available
-        if (!_co_query_image.parse_single<string>(args, in_queryimage) || !_co_filelist.parse_single<string>(args, in_filelist) || !_co_wkdir.parse_single(args, in_wkdir))
-        {
-            print();
-            return false;
-        }
-
-
-        // -----------------------------------------------------------------------------------
-        // either searchptree or searchparams must be given
-        ptree search_params;
         vector<string> in_searchparams;
         if (_co_search_ptree.parse_single<string>(args, in_searchptree))
         {
@@ -143,39 +102,303 @@ public:
             print();
             return false;
         }
-        // -----------------------------------------------------------------------------------
-
-
+        return true;
+    }
 
-        // try to parse the optional num_results parameter
-        _co_num_results.parse_single<size_t>(args, in_numresults);
-		// try to parse the optional outdir parameter
-		if (!_co_outdir.parse_single<string>(args, in_outdir)) {
-			in_outdir = "retrieval_list";
-		}
+    // create the generator; we have the following rule:
+    // a) if the user provides a generator name, we use this and ignore an additional generator ptree
+    // b) if no generator name but ptree is provided, we use this
+    shared_ptr<Generator> create_generator(const std::vector<std::string>& args)
+    {
+        string in_generatorptree;
+        string in_generatorname;
 
-        // -----------------------------------------------------------------
-        // create the generator; we have the following rule:
-        // a) if the user provides a generator name, we use this and ignore an additional generator ptree
-        // b) if no generator name but ptree is provided, we use this
-        shared_ptr<Generator> gen;
+        ptree params;
         if (_co_generator_name.parse_single<string>(args, in_generatorname))
         {
-            gen = Generator::from_default_parameters(in_generatorname);
+            params.put("generator.name", in_generatorname);
         }
         else if (_co_generator_ptree.parse_single<string>(args, in_generatorptree))
         {
-            gen = Generator::from_parameters_file(in_generatorptree);
+            boost::property_tree::read_json(in_generatorptree, params);
         }
         else
         {
             std::cerr << "image_search: must provide either generator name or ptree" << std::endl;
             std::cerr << "received args: generatorname=" << in_generatorname << "; generatorptree=" << in_generatorptree << std::endl;
 
+            print();
+            return shared_ptr<Generator>();
+        }
+
+        // queries may be sampled differently than the indexed images, e.g. more sparsely
+        vector<string> in_querygenerator;
+        if (_co_query_generator.parse_multiple<string>(args, in_querygenerator))
+        {
+            for (size_t i = 0; i < in_querygenerator.size(); i++)
+            {
+                vector<string> pv;
+                boost::algorithm::split(pv, in_querygenerator[i], boost::algorithm::is_any_of("="));
+
+                if (pv.size() != 2)
+                {
+                    std::cerr << "image_search: cannot parse query generator parameter: " << in_querygenerator[i] << std::endl;
+                    return shared_ptr<Generator>();
+                }
+                std::cout << "image_search: query generator parameter generator." << pv[0] << "=" << pv[1] << std::endl;
+                params.put("generator." + pv[0], pv[1]);
+            }
+        }
+
+        return Generator::from_parameters(params);
+    }
+
+    // search parameters and vocabulary, the latter is only required for bag-of-features search
+    bool parse_search_source(const std::vector<std::string>& args, ptree& search_params, string& in_vocabulary)
+    {
+        if (!parse_search_params(args, search_params)) return false;
+
+        // parameter --vocabulary must be given for bag-of-features search
+        if (search_params.get<std::string>("search_type") == "BofSearch" && !_co_vocabulary.parse_single<string>(args, in_vocabulary))
+        {
+            std::cerr << "image_search: when using bag-of-features search, you must also provide the --vocabulary commandline option" << std::endl;
+            print();
+            return false;
+        }
+        return true;
+    }
+
+    // loads generator, vocabulary and search manager once for all queries
+    shared_ptr<ImageSearcher> create_searcher(const std::vector<std::string>& args)
+    {
+        ptree search_params;
+        string in_vocabulary;
+        if (!parse_search_source(args, search_params, in_vocabulary)) return shared_ptr<ImageSearcher>();
+
+        shared_ptr<Generator> gen = create_generator(args);
+        if (!gen) return shared_ptr<ImageSearcher>();
+
+        try {
+            return shared_ptr<ImageSearcher>(new ImageSearcher(gen, search_params, in_vocabulary));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "image_search: error: " << e.what() << std::endl;
+            return shared_ptr<ImageSearcher>();
+        }
+    }
+
+    CmdOption _co_search_ptree;
+    CmdOption _co_search_params;
+    CmdOption _co_vocabulary;
+    CmdOption _co_filelist;
+    CmdOption _co_generator_name;
+    CmdOption _co_generator_ptree;
+    CmdOption _co_query_generator;
+};
+
+
+
+// maps a query "class/name.ext" to its retrieval list "outdir/class/name"
+void retrieval_list_path(const string& query, const string& outdir, string& dir, string& path)
+{
+	std::istringstream sin(query);
+	string retrievalClass;
+	string retrievalFile;
+	std::getline(sin, retrievalClass, '/');
+	std::getline(sin, retrievalFile, '.');
+	dir = outdir + '/' + retrievalClass;
+	path = outdir + '/' + retrievalClass + '/' + retrievalFile;
+}
+
+
+
+// writes the retrieval list of a query, BatchSearch calls this in query order
+struct result_writer
+{
+	result_writer(const FileList& imageFiles, const FileList& queryFiles, const string& outdir)
+		: imageFiles(imageFiles)
+		, queryFiles(queryFiles)
+		, outdir(outdir)
+	{}
+
+	void operator()(size_t query, const vector<dist_idx_t>& results) const
+	{
+		std::cout << "image_search: progress " << query + 1 << '/' << queryFiles.size() << std::endl;
+
+#ifdef SHOW_RESULT
+		// output results on the console
+		// use piping to store in a text file (for now)
+		std::cout << "----------------------------" << std::endl;
+		std::cout << "-idx--score--filename-------" << std::endl;
+		std::cout << "----------------------------" << std::endl;
+		for (size_t i = 0; i < results.size(); i++) {
+			string filename = imageFiles.get_relative_filename(results[i].second);
+			std::cout.precision(9);
+			std::cout << i << " " << (float)results[i].first << " " << filename << std::endl;
+		}
+#endif // SHOW_RESULT
+
+		string outRetrievalListDir, outRetrievalListPath;
+		retrieval_list_path(queryFiles.get_relative_filename(query), outdir, outRetrievalListDir, outRetrievalListPath);
+
+		// store as csv
+		// mkdir outdir/class
+		if (_mkdir(outdir.c_str()) != -1) {
+			printf("\nCreate Dir: %s\n", outdir.c_str());
+		}
+		if (_mkdir(outRetrievalListDir.c_str()) != -1) {
+			printf("\nCreate Dir: %s\n", outRetrievalListDir.c_str());
+		}
+
+		std::ofstream str;
+		str.open(outRetrievalListPath.c_str());
+		if (str.is_open()) {
+			for (size_t i = 0; i < results.size(); i++) {
+				string filename = imageFiles.get_relative_filename(results[i].second);
+				std::istringstream sin1(filename);
+				std::getline(sin1, filename, '.');
+#ifdef SAVE_SCORE
+				double score = results[i].first;
+				str << std::to_string(score) << ' ' << filename << '\n';
+#else
+				str << filename << '\n';
+#endif
+			}
+		}
+	}
+
+	const FileList& imageFiles;
+	const FileList& queryFiles;
+	string outdir;
+};
+
+
+
+// appends the results of a query to a binary result file, see ResultFileWriter
+struct binary_result_writer
+{
+	binary_result_writer(ResultFileWriter& file, size_t num_queries)
+		: file(file)
+		, num_queries(num_queries)
+		, num_written(0)
+	{}
+
+	void operator()(size_t query, const vector<dist_idx_t>& results)
+	{
+		file.add(static_cast<uint32_t>(query), results);
+
+		// a line per query would cost more than the record
+		if (++num_written % 1000 == 0) {
+			std::cout << "image_search: progress " << num_written << '/' << num_queries << std::endl;
+		}
+	}
+
+	ResultFileWriter& file;
+	size_t num_queries;
+	size_t num_written;
+};
+
+
+
+class command_search : public command_searcher
+{
+public:
+
+    command_search()
+        : command_searcher("image_search [options]")
+        , _co_query_image("queryimage"        , "q", "filename of images filelist to be used as the query [required]")
+        , _co_num_results  ("numresults"      , "n", "number of results to search for [optional, if not provided all distances get computed]")
+		, _co_wkdir("working dir"             , "r", "directory path of the query [required]")
+		, _co_outdir("saving dir"             , "o", "the path of the retrieval list saved in [optional, if not provided, will be set as \"retrieval_list\"]")
+        , _co_numthreads("numthreads"         , "t", "number of threads running queries in parallel [optional] (default: number of processors)")
+        , _co_timings("timings"               , "T", "filename to write the time spent in each stage of every query to, as JSON lines if it ends with .jsonl, as CSV otherwise [optional]")
+        , _co_fusion("fusion"                 , "F", "filename of the JSON file describing several searches (generator, vocabulary, search parameters and weight each) whose results are fused, replaces --generatorname/--generatorptree, --vocabulary and --searchptree/--searchparams [optional]")
+        , _co_binary("binary"                 , "B", "filename of a single binary result file receiving the results of all queries instead of one retrieval list per query, an existing file is continued; use \"image_search convert\" to get the retrieval lists [optional]")
+        , _co_deadline("deadline"             , "D", "time budget of each query in ms, queries running out of it return the best results found so far and are reported as truncated [optional] (default: none)")
+    {
+        add(_co_query_image);
+        add(_co_num_results);
+		add(_co_wkdir);
+		add(_co_outdir);
+        add(_co_numthreads);
+        add(_co_timings);
+        add(_co_fusion);
+        add(_co_binary);
+        add(_co_deadline);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+        if (args.size() == 0)
+        {
+            print();
+            return false;
+        }
+
+        warn_for_unknown_option(args);
+
+
+        string in_queryimage;
+        string in_filelist;
+		string in_wkdir;
+		string in_outdir;
+
+        // this default value will make the search managers search
+        // for all images if the user does not provide a value
+        size_t in_numresults = std::numeric_limits<size_t>::max();
+
+
+        // check that the required options are available
+        if (!_co_query_image.parse_single<string>(args, in_queryimage) || !_co_filelist.parse_single<string>(args, in_filelist) || !_co_wkdir.parse_single(args, in_wkdir))
+        {
             print();
             return false;
         }
-        // -----------------------------------------------------------------
+
+
+        // try to parse the optional num_results parameter
+        _co_num_results.parse_single<size_t>(args, in_numresults);
+		// try to parse the optional outdir parameter
+		if (!_co_outdir.parse_single<string>(args, in_outdir)) {
+			in_outdir = "retrieval_list";
+		}
+		// number of threads to be used: by default we use as many
+		// threads as there are processors
+		int in_numthreads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+		if (_co_numthreads.parse_single<int>(args, in_numthreads)) {
+			if (in_numthreads < 1) {
+				std::cout << "image_search: number of threads should be > 0, using default" << std::endl;
+				in_numthreads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+			}
+		}
+
+        // either a single search or the fusion of several ones
+        shared_ptr<ImageSearcher> searcher;
+        shared_ptr<FusedSearcher> fused;
+        vector<const ImageSearcher*> searchers;
+        string in_fusion;
+        if (_co_fusion.parse_single<string>(args, in_fusion))
+        {
+            try {
+                ptree fusion_params;
+                boost::property_tree::read_json(in_fusion, fusion_params);
+                fused.reset(new FusedSearcher(fusion_params));
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "image_search: error: " << e.what() << std::endl;
+                return false;
+            }
+            for (size_t i = 0; i < fused->num_components(); i++) searchers.push_back(&fused->component(i));
+        }
+        else
+        {
+            searcher = create_searcher(args);
+            if (!searcher) return false;
+            searchers.push_back(searcher.get());
+        }
 
 		// load img set file list
         FileList imageFiles;
@@ -187,160 +410,315 @@ public:
 		queryFiles.load(in_queryimage);
 
 
-		// -----------------------------------------------------------------
-		// processing
-		// -----------------------------------------------------------------
-		std::cout << "----------------------------" << std::endl;
-		std::cout << "image_search: now processing..." << std::endl;
-		std::cout << "image_search: working dir is " << in_wkdir << std::endl;
-		for (int i = 0; i < queryFiles.size(); i++)
+		// with a binary result file, all results go to a single file written
+		// by a background thread instead of a text file per query
+		string in_binary;
+		shared_ptr<ResultFileWriter> binaryFile;
+		vector<bool> finished(queryFiles.size(), false);
+		if (_co_binary.parse_single<string>(args, in_binary))
+		{
+			try {
+				binaryFile.reset(new ResultFileWriter(in_binary, queryFiles.size(), true));
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "image_search: error: " << e.what() << std::endl;
+				return false;
+			}
+			for (size_t i = 0; i < binaryFile->finished().size(); i++) finished[binaryFile->finished()[i]] = true;
+		}
+
+		// queries whose results already exist are skipped, such
+		// that an interrupted batch can simply be restarted
+		vector<size_t> queries;
+		for (size_t i = 0; i < queryFiles.size(); i++)
 		{
-			std::cout << "image_search: progress " << i + 1 << '/' << queryFiles.size() << std::endl;
-
-			std::istringstream sin(queryFiles.get_relative_filename(i));
-			string retrievalClass;
-			string retrievalFile;
-			std::getline(sin, retrievalClass, '/');
-			std::getline(sin, retrievalFile, '.');
-			string outRetrievalListDir = in_outdir + '/' + retrievalClass;
-			string outRetrievalListPath = in_outdir + '/' + retrievalClass + '/' + retrievalFile;
+			if (binaryFile) {
+				if (!finished[i]) queries.push_back(i);
+				continue;
+			}
+
+			string outRetrievalListDir, outRetrievalListPath;
+			retrieval_list_path(queryFiles.get_relative_filename(i), in_outdir, outRetrievalListDir, outRetrievalListPath);
 			if ((_access(outRetrievalListPath.c_str(), 0)) != -1) {
 				std::cout << "image_search: progress " << i + 1 << " skipped" << std::endl;
 				continue;
 			}
-			
-			string each_queryimg = queryFiles.get_filename(i);
-			mat_8uc3_t image = cv::imread(each_queryimg, 1);
-			anymap_t data;
-			data["image"] = image;
-
-			gen->compute(data);
-
-			vector<dist_idx_t> results;
-			
-			if (search_params.get<std::string>("search_type") == "BofSearch")
-			{
-
-				// parameter --vocabulary must be given
-				if (!_co_vocabulary.parse_single<string>(args, in_vocabulary))
-				{
-					std::cerr << "image_search: when using bag-of-features search, you must also provide the --vocabulary commandline option" << std::endl;
-					print();
-					return false;
-				}
+			queries.push_back(i);
+		}
+		if (binaryFile && !binaryFile->finished().empty()) {
+			std::cout << "image_search: " << binaryFile->finished().size() << " queries already in " << in_binary << ", skipped" << std::endl;
+		}
 
 
-				vec_vec_f32_t vocabulary;
-				read_property(vocabulary, in_vocabulary);
+		// -----------------------------------------------------------------
+		// processing
+		// -----------------------------------------------------------------
+		std::cout << "----------------------------" << std::endl;
+		std::cout << "image_search: now processing..." << std::endl;
+		std::cout << "image_search: working dir is " << in_wkdir << std::endl;
+		std::cout << "image_search: using " << in_numthreads << " threads" << std::endl;
 
-				// quantize
-				quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
-				vec_vec_f32_t quantized_samples;
+		QTime total;
+		total.start();
 
-				const vec_vec_f32_t& samples = boost::any_cast<vec_vec_f32_t>(data["features"]);
-				quantize_samples_parallel(samples, vocabulary, quantized_samples, quantizer);
+		// per-query timings, the records are only written if requested
+		LatencyReport latency;
+		string in_timings;
+		if (_co_timings.parse_single<string>(args, in_timings))
+		{
+			try {
+				latency.open_records(in_timings);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "image_search: error: " << e.what() << std::endl;
+				return false;
+			}
+		}
 
-				vec_f32_t histvw;
-				build_histvw(quantized_samples, vocabulary.size(), histvw, false);
+		BatchSearch::query_fn query = fused ? BatchSearch::query_fn(boost::bind(&FusedSearcher::query, fused.get(), _1, _2, _3, _4, _5))
+		                                    : BatchSearch::query_fn(boost::bind(&ImageSearcher::query, searcher.get(), _1, _2, _3, _4, _5));
+		BatchSearch batch(query, queryFiles, in_numresults);
 
-				// initialize search manager and run query
-				BofSearchManager bofSearch(search_params);
-				bofSearch.query(histvw, in_numresults, results);
-			}
+		double in_deadline = 0;
+		if (_co_deadline.parse_single<double>(args, in_deadline) && in_deadline > 0)
+		{
+			std::cout << "image_search: deadline of " << in_deadline << "ms per query" << std::endl;
+			batch.set_deadline(in_deadline);
+		}
+		bool okay;
+		if (binaryFile)
+		{
+			binary_result_writer writer(*binaryFile, queries.size());
+			okay = batch.run(queries, in_numthreads, boost::ref(writer), &latency);
 
-			else if (search_params.get<std::string>("search_type") == "LinearSearch")
-			{
-				// Tensor descriptor is a bit of a special case as we additionally
-				// need to pass a 'mask' to the distance function, so we replicate
-				// most of the functionality implemented in LinearSearchManager
-				if (gen->parameters().get<string>("name") == "tensor")
-				{
-					string filename = search_params.get<string>("descriptor_file");
-					vec_vec_f32_t features;
-					read_property(features, filename);
-
-					const vec_f32_t& descr = get<vec_f32_t>(data, "features");
-					const vector<bool>& mask = get<vector<bool> >(data, "mask");
-					std::cout << "mask size=" << mask.size() << std::endl;
-					dist_frobenius<vec_f32_t> distfn;
-					distfn.mask = &mask;
-					linear_search(descr, features, results, in_numresults, distfn);
-
-				}
-				else
-				{
-					LinearSearchManager search(search_params);
-					image_search(data, search, in_numresults, results);
-				}
+			// the results finished so far are kept even if a query failed
+			try {
+				binaryFile->close();
 			}
-			else
+			catch (const std::exception& e)
 			{
-				std::cerr << "unsupported search type" << std::endl;
+				std::cerr << "image_search: error: " << e.what() << std::endl;
+				return false;
 			}
+		}
+		else
+		{
+			result_writer writer(imageFiles, queryFiles, in_outdir);
+			okay = batch.run(queries, in_numthreads, boost::ref(writer), &latency);
+		}
+		if (!okay)
+		{
+			std::cerr << "image_search: stopped after " << batch.num_finished() << " of " << queries.size() << " queries" << std::endl;
+			return false;
+		}
 
+		int totalMSElapsed = total.elapsed();
+		std::cout << "image_search: " << queries.size() << " queries in " << (totalMSElapsed / 1000) << "s";
+		if (totalMSElapsed > 0) std::cout << " (" << queries.size() * 1000.0 / totalMSElapsed << " queries/s)";
+		std::cout << std::endl;
 
-#ifdef SHOW_RESULT
-			// output results on the console
-			// use piping to store in a text file (for now)
-			std::cout << "----------------------------" << std::endl;
-			std::cout << "-idx--score--filename-------" << std::endl;
-			std::cout << "----------------------------" << std::endl;
-			for (size_t i = 0; i < results.size(); i++) {
-				string filename = imageFiles.get_relative_filename(results[i].second);
-				std::cout.precision(9);
-				std::cout << i << " " << (float)results[i].first << " " << filename << std::endl;
-			}
-#endif // SHOW_RESULT
+		std::cout << "image_search: ";
+		latency.print(std::cout);
 
-			// store as csv
-			// mkdir outdir/class
-			if (_mkdir(in_outdir.c_str()) != -1) {
-				printf("\nCreate Dir: %s\n", in_outdir.c_str());
-			}
-			if (_mkdir(outRetrievalListDir.c_str()) != -1) {
-				printf("\nCreate Dir: %s\n", outRetrievalListDir.c_str());
+		for (size_t i = 0; i < searchers.size(); i++)
+		{
+			// effect of query term pruning, if enabled in the search parameters
+			if (searchers[i]->bof_search() && searchers[i]->bof_search()->pruning().num_queries)
+			{
+				std::cout << "image_search: ";
+				searchers[i]->bof_search()->pruning().print(std::cout);
 			}
 
-			std::ofstream str;
-			str.open(outRetrievalListPath.c_str());
-			if (str.is_open()) {
-				for (size_t i = 0; i < results.size(); i++) {
-					string filename = imageFiles.get_relative_filename(results[i].second);
-					std::istringstream sin1(filename);
-					std::getline(sin1, filename, '.');
-#ifdef SAVE_SCORE
-					double score = results[i].first;
-					str << std::to_string(score) << ' ' << filename << '\n';
-#else
-					str << filename << '\n';
-#endif
-				}
+			if (searchers[i]->cache())
+			{
+				std::cout << "image_search: ";
+				searchers[i]->cache()->stats().print(std::cout);
 			}
 		}
 
 
-
         return true;
     }
 
 private:
 
     CmdOption _co_query_image;
-    CmdOption _co_search_ptree;
-    CmdOption _co_search_params;
-    CmdOption _co_vocabulary;
-    CmdOption _co_filelist;
-    CmdOption _co_generator_name;
-    CmdOption _co_generator_ptree;
     CmdOption _co_num_results;
 	CmdOption _co_wkdir;
 	CmdOption _co_outdir;
+    CmdOption _co_numthreads;
+    CmdOption _co_timings;
+    CmdOption _co_fusion;
+    CmdOption _co_binary;
+    CmdOption _co_deadline;
+};
+
+
+
+class command_serve : public command_searcher
+{
+public:
+
+    command_serve()
+        : command_searcher("image_search serve [options]")
+        , _co_socket("socket"                 , "S", "path of the Unix domain socket to listen on, or a TCP port on the loopback interface [required]")
+        , _co_batch_size("batchsize"          , "b", "maximum number of concurrent queries run as one batch, 1 disables batching [optional] (default: 32)")
+        , _co_batch_window("batchwindow"      , "w", "maximum time in ms a query waits for further queries to share its batch [optional] (default: 2)")
+        , _co_deadline("deadline"             , "D", "time budget of each query in ms counted from its receipt, queries running out of it are answered with the best results found so far and StatusTruncated, requires --batchsize 1 [optional] (default: none)")
+    {
+        add(_co_socket);
+        add(_co_batch_size);
+        add(_co_batch_window);
+        add(_co_deadline);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+        warn_for_unknown_option(args);
+
+        string in_socket;
+        search_source source;
+        if (!_co_socket.parse_single<string>(args, in_socket) || !_co_filelist.parse_single<string>(args, source.filelist_file))
+        {
+            print();
+            return false;
+        }
+
+        size_t in_batchsize = 32;
+        int in_batchwindow = 2;
+        double in_deadline = 0;
+        _co_batch_size.parse_single<size_t>(args, in_batchsize);
+        _co_batch_window.parse_single<int>(args, in_batchwindow);
+        _co_deadline.parse_single<double>(args, in_deadline);
+
+        if (!parse_search_source(args, source.search_params, source.vocabulary_file)) return false;
+
+        shared_ptr<Generator> gen = create_generator(args);
+        if (!gen) return false;
+
+        try {
+            SearchServer server(gen, source, in_batchsize, in_batchwindow, in_deadline);
+            server.run(in_socket);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "image_search: error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    CmdOption _co_socket;
+    CmdOption _co_batch_size;
+    CmdOption _co_batch_window;
+    CmdOption _co_deadline;
+};
+
+
+
+// writes the retrieval lists of a binary result file in the layout of command_search
+class command_convert : public Command
+{
+public:
+
+    command_convert()
+        : Command("image_search convert [options]")
+        , _co_binary("binary"          , "B", "filename of the binary result file written by image_search --binary [required]")
+        , _co_filelist("filelist"      , "l", "filename of images filelist the results refer to [required]")
+        , _co_query_image("queryimage" , "q", "filename of the query filelist used for the search [required]")
+        , _co_outdir("saving dir"      , "o", "the path of the retrieval list saved in [optional, if not provided, will be set as \"retrieval_list\"]")
+    {
+        add(_co_binary);
+        add(_co_filelist);
+        add(_co_query_image);
+        add(_co_outdir);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+        warn_for_unknown_option(args);
+
+        string in_binary;
+        string in_filelist;
+        string in_queryimage;
+        string in_outdir = "retrieval_list";
+        if (!_co_binary.parse_single<string>(args, in_binary) || !_co_filelist.parse_single<string>(args, in_filelist) || !_co_query_image.parse_single<string>(args, in_queryimage))
+        {
+            print();
+            return false;
+        }
+        _co_outdir.parse_single<string>(args, in_outdir);
+
+        try {
+            FileList imageFiles;
+            imageFiles.load(in_filelist);
+            FileList queryFiles;
+            queryFiles.load(in_queryimage);
+
+            ResultFileReader reader(in_binary);
+            if (reader.num_queries() != queryFiles.size())
+            {
+                std::cerr << "image_search: " << in_binary << " was written for " << reader.num_queries() << " queries, but "
+                          << in_queryimage << " contains " << queryFiles.size() << std::endl;
+                return false;
+            }
+
+            result_writer writer(imageFiles, queryFiles, in_outdir);
+            uint32_t query;
+            vector<dist_idx_t> results;
+            size_t numConverted = 0;
+            while (reader.next(query, results))
+            {
+                if (query >= queryFiles.size()) throw std::runtime_error("query index out of range in " + in_binary);
+                writer(query, results);
+                numConverted++;
+            }
+            std::cout << "image_search: converted " << numConverted << " of " << queryFiles.size() << " queries" << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "image_search: error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    CmdOption _co_binary;
+    CmdOption _co_filelist;
+    CmdOption _co_query_image;
+    CmdOption _co_outdir;
 };
 
 
 
 int main(int argc, char *argv[])
 {
+    // "image_search serve [options]" loads everything once and answers
+    // queries over a socket, otherwise run a batch of queries
+    if (argc > 1 && string(argv[1]) == "serve")
+    {
+        command_serve cmd;
+        bool okay = cmd.run(argv_to_strings(argc-2, &argv[2]));
+        return okay ? 0:1;
+    }
+
+    // "image_search convert [options]" turns a binary result file into retrieval lists
+    if (argc > 1 && string(argv[1]) == "convert")
+    {
+        command_convert cmd;
+        bool okay = cmd.run(argv_to_strings(argc-2, &argv[2]));
+        return okay ? 0:1;
+    }
 
     command_search cmd;
     bool okay = cmd.run(argv_to_strings(argc-1, &argv[1]));
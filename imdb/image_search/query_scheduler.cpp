@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "query_scheduler.hpp"
+
+#include <stdexcept>
+#include <cassert>
+
+#include <boost/bind.hpp>
+
+namespace imdb {
+
+QueryScheduler::QueryScheduler(const ImageSearcher& searcher, size_t max_batch_size, int max_wait_ms)
+    : _searcher(searcher)
+    , _maxBatchSize(std::max<size_t>(max_batch_size, 1))
+    , _maxWaitMs(std::max(max_wait_ms, 0))
+    , _stop(false)
+{
+    _thread = boost::thread(boost::bind(&QueryScheduler::thread_main, this));
+}
+
+
+QueryScheduler::~QueryScheduler()
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _stop = true;
+    }
+    _queryAdded.notify_all();
+    _thread.join();
+}
+
+
+void QueryScheduler::query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results)
+{
+    request r;
+    r.image = &image;
+    r.num_results = num_results;
+    r.results = &results;
+    r.arrival = boost::get_system_time();
+    r.done = false;
+
+    boost::mutex::scoped_lock lock(_mutex);
+    if (_stop) throw std::runtime_error("QueryScheduler: scheduler has been stopped");
+
+    _queue.push_back(&r);
+    _queryAdded.notify_all();
+
+    while (!r.done) _batchDone.wait(lock);
+
+    if (!r.error.empty()) throw std::runtime_error(r.error);
+}
+
+
+void QueryScheduler::thread_main()
+{
+    for (;;)
+    {
+        vector<request*> batch;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+
+            while (_queue.empty() && !_stop) _queryAdded.wait(lock);
+            if (_queue.empty()) return;
+
+            // wait for further queries until the batch is full or the
+            // oldest query has waited long enough, don't wait when stopping
+            const boost::system_time deadline = _queue.front()->arrival + boost::posix_time::milliseconds(_maxWaitMs);
+            while (_queue.size() < _maxBatchSize && !_stop)
+            {
+                if (!_queryAdded.timed_wait(lock, deadline)) break;
+            }
+
+            while (!_queue.empty() && batch.size() < _maxBatchSize)
+            {
+                batch.push_back(_queue.front());
+                _queue.pop_front();
+            }
+        }
+
+        run_batch(batch);
+
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            for (size_t i = 0; i < batch.size(); i++) batch[i]->done = true;
+        }
+        _batchDone.notify_all();
+    }
+}
+
+
+void QueryScheduler::run_batch(const vector<request*>& batch)
+{
+    assert(!batch.empty());
+
+    // the batch is run for the largest number of results
+    // requested, the results of each query are cut afterwards
+    vector<mat_8uc3_t> images(batch.size());
+    size_t numResults = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        images[i] = *batch[i]->image;
+        numResults = std::max(numResults, batch[i]->num_results);
+    }
+
+    vector<vector<dist_idx_t> > results;
+    vector<string> errors;
+    try {
+        _searcher.query_batch(images, numResults, results, errors);
+    }
+    catch (const std::exception& e)
+    {
+        results.assign(batch.size(), vector<dist_idx_t>());
+        errors.assign(batch.size(), e.what());
+    }
+
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        request& r = *batch[i];
+        r.error = errors[i];
+        if (results[i].size() > r.num_results) results[i].resize(r.num_results);
+        r.results->swap(results[i]);
+    }
+}
+
+} // end namespace imdb
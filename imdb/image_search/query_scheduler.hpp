@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef QUERY_SCHEDULER_HPP
+#define QUERY_SCHEDULER_HPP
+
+#include <deque>
+
+#include <boost/utility.hpp>
+#include <boost/thread.hpp>
+
+#include "types.hpp"
+#include "image_searcher.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Collects concurrent queries into small batches (micro-batching).
+ *
+ * Any number of threads (e.g. the connection threads of a SearchServer) call query(), which blocks until
+ * the result is available. A single scheduler thread collects the waiting queries until either
+ * max_batch_size queries are waiting or the oldest of them has waited for max_wait_ms, and runs them
+ * together using ImageSearcher::query_batch(). The quantization of all samples and the traversal of
+ * posting lists shared by several queries are then done once per batch, which increases the throughput
+ * under load. The latency of a single query grows by at most max_wait_ms plus the time needed for the
+ * other queries of its batch.
+ */
+class QueryScheduler : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Starts the scheduler thread.
+     * @param searcher Query pipeline, must outlive the scheduler
+     * @param max_batch_size A batch is started as soon as this many queries are waiting
+     * @param max_wait_ms A batch is started at the latest this many milliseconds after its first query arrived
+     */
+    QueryScheduler(const ImageSearcher& searcher, size_t max_batch_size, int max_wait_ms);
+
+    /// Answers all queries still waiting and stops the scheduler thread
+    ~QueryScheduler();
+
+    /**
+     * @brief Searches the most similar images, blocks until the batch containing this query has been run.
+     * @param image Query image
+     * @param num_results Desired number of results
+     * @param results Result indices into the searched collection in order of descending similarity
+     * @throw std::runtime_error if the query failed
+     */
+    void query(const mat_8uc3_t& image, size_t num_results, vector<dist_idx_t>& results);
+
+private:
+
+    struct request
+    {
+        const mat_8uc3_t*   image;
+        size_t              num_results;
+        vector<dist_idx_t>* results;
+        boost::system_time  arrival;
+        string              error;
+        bool                done;
+    };
+
+    void thread_main();
+
+    void run_batch(const vector<request*>& batch);
+
+    const ImageSearcher&      _searcher;
+    size_t                    _maxBatchSize;
+    int                       _maxWaitMs;
+
+    // queries waiting to be scheduled, owned by the calling threads
+    std::deque<request*>      _queue;
+    bool                      _stop;
+
+    boost::mutex              _mutex;
+    boost::condition_variable _queryAdded;
+    boost::condition_variable _batchDone;
+    boost::thread             _thread;
+};
+
+} // end namespace imdb
+
+#endif // QUERY_SCHEDULER_HPP
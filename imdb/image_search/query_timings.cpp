@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "query_timings.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace imdb {
+
+namespace {
+
+// nearest-rank percentile of sorted values
+double percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+// escapes quotes and backslashes of a JSON string value
+string json_escape(const string& s)
+{
+    string r;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\') r += '\\';
+        r += s[i];
+    }
+    return r;
+}
+
+// doubles the quotes of a quoted CSV field
+string csv_escape(const string& s)
+{
+    string r;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"') r += '"';
+        r += s[i];
+    }
+    return r;
+}
+
+} // end anonymous namespace
+
+
+double query_timings::total() const
+{
+    double sum = 0;
+    for (int i = 0; i < NumStages; i++) sum += ms[i];
+    return sum;
+}
+
+
+const char* query_timings::stage_name(int stage)
+{
+    static const char* names[NumStages] = {"decode", "compute", "quantize", "histogram", "score", "select", "write"};
+    return (stage >= 0 && stage < NumStages) ? names[stage] : "total";
+}
+
+
+void LatencyReport::open_records(const string& filename)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    _records.open(filename.c_str());
+    if (!_records.is_open()) throw std::ios_base::failure("could not open timings file " + filename);
+
+    _jsonl = boost::algorithm::iends_with(filename, ".jsonl") || boost::algorithm::iends_with(filename, ".json");
+    if (!_jsonl)
+    {
+        _records << "query";
+        for (int i = 0; i < query_timings::NumStages; i++) _records << ',' << query_timings::stage_name(i) << "_ms";
+        _records << ",total_ms,truncated\n";
+    }
+}
+
+
+void LatencyReport::add(const string& query, const query_timings& timings)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    _timings.push_back(timings);
+
+    if (!_records.is_open()) return;
+
+    if (_jsonl)
+    {
+        _records << "{\"query\":\"" << json_escape(query) << '"';
+        for (int i = 0; i < query_timings::NumStages; i++) _records << ",\"" << query_timings::stage_name(i) << "_ms\":" << timings.ms[i];
+        _records << ",\"total_ms\":" << timings.total() << ",\"truncated\":" << (timings.truncated ? "true" : "false") << "}\n";
+    }
+    else
+    {
+        _records << '"' << csv_escape(query) << '"';
+        for (int i = 0; i < query_timings::NumStages; i++) _records << ',' << timings.ms[i];
+        _records << ',' << timings.total() << ',' << (timings.truncated ? 1 : 0) << '\n';
+    }
+}
+
+
+size_t LatencyReport::size() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _timings.size();
+}
+
+
+void LatencyReport::print(std::ostream& stream) const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+
+    const std::streamsize precision = stream.precision();
+    stream << "latency of " << _timings.size() << " queries [ms]" << std::endl;
+    stream << std::setw(12) << "stage" << std::setw(10) << "p50" << std::setw(10) << "p95"
+           << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+
+    // the last row is the total
+    for (int stage = 0; stage <= query_timings::NumStages; stage++)
+    {
+        vector<double> values(_timings.size());
+        for (size_t i = 0; i < _timings.size(); i++)
+        {
+            values[i] = (stage < query_timings::NumStages) ? _timings[i].ms[stage] : _timings[i].total();
+        }
+        std::sort(values.begin(), values.end());
+
+        stream << std::setw(12) << query_timings::stage_name(stage) << std::fixed << std::setprecision(3)
+               << std::setw(10) << percentile(values, 50) << std::setw(10) << percentile(values, 95)
+               << std::setw(10) << percentile(values, 99) << std::setw(10) << (values.empty() ? 0 : values.back())
+               << std::endl;
+    }
+    stream.unsetf(std::ios_base::floatfield);
+    stream.precision(precision);
+
+    size_t numTruncated = 0;
+    for (size_t i = 0; i < _timings.size(); i++) if (_timings[i].truncated) numTruncated++;
+    if (numTruncated > 0) stream << numTruncated << " of " << _timings.size() << " queries truncated by their deadline" << std::endl;
+}
+
+} // end namespace imdb
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef QUERY_TIMINGS_HPP
+#define QUERY_TIMINGS_HPP
+
+#include <fstream>
+#include <ostream>
+
+#include <boost/utility.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Time spent in each stage of a single query, in milliseconds.
+ *
+ * Stages that do not apply to a query (e.g. quantization in linear search) stay 0. For linear search
+ * the distance computation and the selection of the best results are a single step, counted as Score.
+ */
+struct query_timings
+{
+    enum stage
+    {
+        Decode = 0,   ///< reading and decoding the query image
+        Compute,      ///< feature extraction by the generator
+        Quantize,     ///< quantization of the features against the vocabulary
+        Histogram,    ///< building the histogram of visual words
+        Score,        ///< scoring the index (or the linear search)
+        Select,       ///< selecting the best results from the scores, including re-ranking them
+        Write,        ///< writing the results
+        NumStages
+    };
+
+    query_timings() : truncated(false) { for (int i = 0; i < NumStages; i++) ms[i] = 0; }
+
+    /// Sum over all stages
+    double total() const;
+
+    /// Short lowercase name of a stage, used in the records and reports
+    static const char* stage_name(int stage);
+
+    double ms[NumStages];
+
+    /// True if the query ran out of its deadline and returned truncated results, see Deadline
+    bool   truncated;
+};
+
+
+/**
+ * @ingroup search
+ * @brief Measures wall clock time using a steady high resolution clock.
+ */
+class Stopwatch
+{
+public:
+
+    Stopwatch() : _start(boost::chrono::steady_clock::now()) {}
+
+    /// Milliseconds since construction or the last restart()
+    double elapsed_ms() const
+    {
+        return boost::chrono::duration<double, boost::milli>(boost::chrono::steady_clock::now() - _start).count();
+    }
+
+    /// Returns elapsed_ms() and restarts the measurement
+    double restart_ms()
+    {
+        boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+        double ms = boost::chrono::duration<double, boost::milli>(now - _start).count();
+        _start = now;
+        return ms;
+    }
+
+private:
+
+    boost::chrono::steady_clock::time_point _start;
+};
+
+
+/**
+ * @ingroup search
+ * @brief Collects the timings of all queries of a run.
+ *
+ * Optionally writes one record per query as soon as it is added, either as CSV (one column per stage)
+ * or as JSON lines, depending on the extension of the file. At the end of a run print() reports the
+ * 50th, 95th and 99th percentile of each stage. All functions are thread-safe.
+ */
+class LatencyReport : public boost::noncopyable
+{
+public:
+
+    LatencyReport() : _jsonl(false) {}
+
+    /**
+     * @brief Writes the record of every query added from now on to a file.
+     * @param filename Records are written as JSON lines if the filename ends with ".jsonl" or ".json", as CSV otherwise
+     * @throw std::ios_base::failure if the file cannot be opened
+     */
+    void open_records(const string& filename);
+
+    /// Adds the timings of a query, \p query identifies the query in the records (e.g. its filename)
+    void add(const string& query, const query_timings& timings);
+
+    /// Number of queries added so far
+    size_t size() const;
+
+    /// Prints p50/p95/p99/max of each stage and of the total over all queries added so far,
+    /// and the number of truncated queries if there were any
+    void print(std::ostream& stream) const;
+
+private:
+
+    vector<query_timings> _timings;
+
+    std::ofstream         _records;
+    bool                  _jsonl;
+
+    mutable boost::mutex  _mutex;
+};
+
+} // end namespace imdb
+
+#endif // QUERY_TIMINGS_HPP
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "reranker.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+
+namespace imdb {
+
+Reranker::Reranker(const string& descriptor_file, const string& distfn)
+    : _filename(descriptor_file)
+    , _size(0)
+    , _dims(0)
+{
+    _distfn = distance_functions<vec_f32_t>().make(distfn);
+    if (!_distfn) throw std::runtime_error("unknown distance function: " + distfn);
+
+    // the first reader also tells us the number of descriptors
+    shared_ptr<reader_t> reader(new reader_t(descriptor_file));
+    _size = static_cast<size_t>(reader->size());
+    _readers.push_back(reader);
+
+    // all descriptors are expected to be of the size of the first one, see rerank()
+    if (_size > 0)
+    {
+        vec_f32_t descr;
+        reader->get(descr, 0);
+        _dims = descr.size();
+    }
+}
+
+
+void Reranker::rerank(const vec_f32_t& query, vector<dist_idx_t>& candidates, size_t num_results) const
+{
+    const int numCandidates = static_cast<int>(candidates.size());
+
+    // the distance functions iterate over the query and expect the other descriptor to be of the same size
+    if (numCandidates > 0 && query.size() != _dims)
+    {
+        throw std::runtime_error("Reranker: query has " + boost::lexical_cast<string>(query.size()) + " dimensions, the descriptors in "
+                                 + _filename + " have " + boost::lexical_cast<string>(_dims));
+    }
+
+    for (int i = 0; i < numCandidates; i++)
+    {
+        if (candidates[i].second < 0 || static_cast<size_t>(candidates[i].second) >= _size)
+        {
+            throw std::runtime_error("Reranker: candidate out of range of " + _filename);
+        }
+    }
+
+    // exceptions must not leave the parallel region below, so we
+    // remember the first error and throw it afterwards
+    string error;
+
+    #pragma omp parallel if (numCandidates > 64)
+    {
+        shared_ptr<reader_t> reader;
+        try {
+            reader = acquire_reader();
+        }
+        catch (const std::exception& e)
+        {
+            #pragma omp critical (reranker_error)
+            if (error.empty()) error = e.what();
+        }
+
+        vec_f32_t descr;
+        bool failed = !reader;
+
+        // every thread has to reach the loop, even without a reader
+        #pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < numCandidates; i++)
+        {
+            if (failed) continue;
+            try {
+                reader->get(descr, candidates[i].second);
+                if (descr.size() != query.size()) throw std::runtime_error("descriptor " + boost::lexical_cast<string>(candidates[i].second) + " differs in size from the query");
+                candidates[i].first = _distfn(query, descr);
+            }
+            catch (const std::exception& e)
+            {
+                failed = true;
+                #pragma omp critical (reranker_error)
+                if (error.empty()) error = e.what();
+            }
+        }
+
+        // a reader that failed may be left in a bad state
+        if (!failed) release_reader(reader);
+    }
+
+    if (!error.empty()) throw std::runtime_error("Reranker: could not read " + _filename + ": " + error);
+
+    // ascending distance, ties are broken by the document index
+    num_results = std::min(num_results, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + num_results, candidates.end());
+    candidates.resize(num_results);
+}
+
+
+shared_ptr<Reranker::reader_t> Reranker::acquire_reader() const
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (!_readers.empty())
+        {
+            shared_ptr<reader_t> reader = _readers.back();
+            _readers.pop_back();
+            return reader;
+        }
+    }
+
+    // opening the file reads its offsets, so don't hold the lock meanwhile
+    return shared_ptr<reader_t>(new reader_t(_filename));
+}
+
+
+void Reranker::release_reader(const shared_ptr<reader_t>& reader) const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _readers.push_back(reader);
+}
+
+} // end namespace imdb
@@ -0,0 +1,81 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef RERANKER_HPP
+#define RERANKER_HPP
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+#include "distance.hpp"
+#include "property_reader.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Second stage of a two-stage search: re-scores a short list of candidates exactly.
+ *
+ * The candidates found by a fast but coarse first stage (e.g. the inverted index) are compared to the
+ * query using their full descriptors and a distance function, which gives the ranking a linear search
+ * over the same descriptors would give, at the cost of only a few hundred distance computations.
+ *
+ * The descriptors are not loaded into memory but read on demand from a property file using the random
+ * access of PropertyReaderT. As a reader is not thread-safe, each thread (of concurrent queries as well
+ * as of the OpenMP team scoring the candidates of a single query) takes its own reader from a pool.
+ */
+class Reranker : public boost::noncopyable
+{
+public:
+
+    /**
+     * @param descriptor_file Property file of vec_f32_t descriptors, one per document of the first stage
+     * in the same order, e.g. the histograms of visual words written by compute_histvw
+     * @param distfn Name of the distance function, see distance_functions<T>.make()
+     * @throw std::runtime_error if the distance function is unknown or the file cannot be read
+     */
+    Reranker(const string& descriptor_file, const string& distfn);
+
+    /**
+     * @brief Replaces the scores of the candidates by their distance to the query and keeps the best ones.
+     * @param query Descriptor of the query, of the same kind as the stored descriptors
+     * @param candidates Candidates of the first stage, on return the (at most) \p num_results candidates
+     * with the smallest distance in ascending order of distance
+     * @param num_results Number of candidates to keep
+     * @throw std::runtime_error if a candidate is out of range, its descriptor cannot be read or differs
+     * in size from \p query
+     */
+    void rerank(const vec_f32_t& query, vector<dist_idx_t>& candidates, size_t num_results) const;
+
+    /// Number of stored descriptors
+    size_t size() const {return _size;}
+
+    /// Number of dimensions of the stored descriptors, 0 if there are none
+    size_t dims() const {return _dims;}
+
+private:
+
+    typedef PropertyReaderT<vec_f32_t> reader_t;
+
+    shared_ptr<reader_t> acquire_reader() const;
+    void release_reader(const shared_ptr<reader_t>& reader) const;
+
+    string                                      _filename;
+    distance_functions<vec_f32_t>::distfn_t     _distfn;
+    size_t                                      _size;
+    size_t                                      _dims;
+
+    // readers not used by any thread at the moment
+    mutable vector<shared_ptr<reader_t> >       _readers;
+    mutable boost::mutex                        _mutex;
+};
+
+} // end namespace imdb
+
+#endif // RERANKER_HPP
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "result_cache.hpp"
+
+#include <cstring>
+
+namespace imdb {
+
+void result_cache_stats::print(std::ostream& stream) const
+{
+    const uint64_t lookups = hits + misses;
+    stream << "result cache: " << hits << " hits, " << misses << " misses";
+    if (lookups) stream << " (hit rate " << 100.0 * hits / lookups << "%)";
+    stream << ", " << evictions << " evictions, " << entries << " entries using "
+           << bytes / 1024 << "KB of " << max_bytes / 1024 << "KB" << std::endl;
+}
+
+
+ResultCache::ResultCache(size_t max_bytes)
+{
+    _stats.max_bytes = max_bytes;
+}
+
+
+bool ResultCache::lookup(const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& results)
+{
+    key_t key;
+    uint64_t hash;
+    make_key(descr, key, hash);
+
+    boost::mutex::scoped_lock lock(_mutex);
+
+    list_t::iterator it = find(key, hash);
+
+    // an entry with fewer results than it has been computed for
+    // contains all documents and thus answers any query
+    if (it == _entries.end() || (it->num_results < num_results && it->results.size() == it->num_results))
+    {
+        _stats.misses++;
+        return false;
+    }
+
+    _entries.splice(_entries.begin(), _entries, it);
+    results.assign(it->results.begin(), it->results.begin() + std::min(num_results, it->results.size()));
+    _stats.hits++;
+    return true;
+}
+
+
+void ResultCache::insert(const vec_f32_t& descr, size_t num_results, const vector<dist_idx_t>& results)
+{
+    key_t key;
+    uint64_t hash;
+    make_key(descr, key, hash);
+
+    const size_t bytes = sizeof(entry) + key.size() * sizeof(key_t::value_type) + results.size() * sizeof(dist_idx_t);
+    if (bytes > _stats.max_bytes) return;
+
+    boost::mutex::scoped_lock lock(_mutex);
+
+    list_t::iterator it = find(key, hash);
+    if (it != _entries.end())
+    {
+        if (it->num_results >= num_results) return;
+        erase(it);
+    }
+
+    while (!_entries.empty() && _stats.bytes + bytes > _stats.max_bytes)
+    {
+        erase(--_entries.end());
+        _stats.evictions++;
+    }
+
+    _entries.push_front(entry());
+    entry& e = _entries.front();
+    e.hash = hash;
+    e.key.swap(key);
+    e.num_results = num_results;
+    e.results = results;
+    e.bytes = bytes;
+
+    _index.insert(std::make_pair(hash, _entries.begin()));
+    _stats.entries++;
+    _stats.bytes += bytes;
+}
+
+
+void ResultCache::clear()
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    _entries.clear();
+    _index.clear();
+    _stats.entries = 0;
+    _stats.bytes = 0;
+}
+
+
+result_cache_stats ResultCache::stats() const
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    return _stats;
+}
+
+
+void ResultCache::make_key(const vec_f32_t& descr, key_t& key, uint64_t& hash)
+{
+    key.clear();
+    for (size_t i = 0; i < descr.size(); i++)
+    {
+        if (descr[i] != 0) key.push_back(std::make_pair(static_cast<uint32_t>(i), descr[i]));
+    }
+
+    // FNV-1a over the non-zero entries and the length of the descriptor
+    hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+
+    uint64_t length = descr.size();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(&length);
+    for (size_t b = 0; b < sizeof(length); b++) hash = (hash ^ p[b]) * prime;
+
+    for (size_t i = 0; i < key.size(); i++)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &key[i].second, sizeof(bits));
+        const uint32_t words[2] = {key[i].first, bits};
+        p = reinterpret_cast<const unsigned char*>(words);
+        for (size_t b = 0; b < sizeof(words); b++) hash = (hash ^ p[b]) * prime;
+    }
+
+    // distinguishes descriptors of different length that share the same non-zero entries
+    key.push_back(std::make_pair(static_cast<uint32_t>(descr.size()), 0.0f));
+}
+
+
+ResultCache::list_t::iterator ResultCache::find(const key_t& key, uint64_t hash)
+{
+    std::pair<map_t::iterator, map_t::iterator> range = _index.equal_range(hash);
+    for (map_t::iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second->key == key) return it->second;
+    }
+    return _entries.end();
+}
+
+
+void ResultCache::erase(list_t::iterator it)
+{
+    std::pair<map_t::iterator, map_t::iterator> range = _index.equal_range(it->hash);
+    for (map_t::iterator mi = range.first; mi != range.second; ++mi)
+    {
+        if (mi->second == it) { _index.erase(mi); break; }
+    }
+
+    _stats.entries--;
+    _stats.bytes -= it->bytes;
+    _entries.erase(it);
+}
+
+} // end namespace imdb
@@ -0,0 +1,265 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "result_file.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+namespace imdb {
+
+static const char result_magic[8] = { 'I', 'M', 'D', 'B', 'R', 'S', 'L', 'T' };
+
+// add() hands a buffer to the writer thread once it holds this many bytes
+static const size_t result_buffer_size = 1 << 20;
+
+// add() blocks while this many full buffers are waiting to be written
+static const size_t result_max_pending = 8;
+
+
+ResultFileReader::ResultFileReader(const string& filename)
+    : _validSize(0)
+{
+    _ifs.open(filename.c_str(), std::ifstream::binary);
+    if (!_ifs.is_open()) throw std::ios_base::failure("could not open result file " + filename);
+
+    _ifs.read(reinterpret_cast<char*>(&_header), sizeof(_header));
+    if (!_ifs.good() || std::memcmp(_header.magic, result_magic, sizeof(_header.magic)) != 0)
+    {
+        throw std::runtime_error("file " + filename + " is not a result file");
+    }
+    if (_header.version != result_file::version)
+    {
+        throw std::runtime_error("version of file " + filename + " is different from program version");
+    }
+
+    _validSize = sizeof(_header);
+}
+
+
+bool ResultFileReader::next(uint32_t& query, vector<dist_idx_t>& results)
+{
+    result_file::record_header r;
+    _ifs.read(reinterpret_cast<char*>(&r), sizeof(r));
+    if (!_ifs.good()) return false;
+
+    _ids.resize(r.num_results);
+    _scores.resize(r.num_results);
+    if (r.num_results)
+    {
+        _ifs.read(reinterpret_cast<char*>(&_ids[0]), r.num_results * sizeof(uint32_t));
+        _ifs.read(reinterpret_cast<char*>(&_scores[0]), r.num_results * sizeof(float));
+        if (!_ifs.good()) return false;
+    }
+
+    query = r.query;
+    results.resize(r.num_results);
+    for (size_t i = 0; i < results.size(); i++) results[i] = dist_idx_t(_scores[i], _ids[i]);
+
+    _validSize += sizeof(r) + r.num_results * (sizeof(uint32_t) + sizeof(float));
+    return true;
+}
+
+
+
+ResultFileWriter::ResultFileWriter(const string& filename, uint64_t num_queries, bool resume)
+    : _stop(false)
+    , _failed(false)
+{
+    bool exists = false;
+    if (resume)
+    {
+        std::ifstream test(filename.c_str(), std::ifstream::binary | std::ifstream::ate);
+        exists = test.is_open();
+
+        const uint64_t size = exists ? static_cast<uint64_t>(test.tellg()) : 0;
+        test.close();
+
+        // killed before even the header reached the disk, nothing to resume
+        if (exists && size < sizeof(result_file::header))
+        {
+            std::cout << "ResultFileWriter: " << filename << " has no complete header, starting over" << std::endl;
+            exists = false;
+        }
+
+        if (exists)
+        {
+
+            ResultFileReader reader(filename);
+            if (reader.num_queries() != num_queries)
+            {
+                throw std::runtime_error("result file " + filename + " was written for a different query filelist");
+            }
+
+            uint32_t query;
+            vector<dist_idx_t> results;
+            while (reader.next(query, results)) _finished.push_back(query);
+
+            const uint64_t valid = reader.valid_size();
+            if (valid < size)
+            {
+                std::cout << "ResultFileWriter: dropping truncated record at the end of " << filename << std::endl;
+                truncate(filename, valid);
+            }
+        }
+    }
+
+    if (exists)
+    {
+        _ofs.open(filename.c_str(), std::ofstream::binary | std::ofstream::app);
+        if (!_ofs.is_open()) throw std::ios_base::failure("could not open result file " + filename);
+    }
+    else
+    {
+        _ofs.open(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+        if (!_ofs.is_open()) throw std::ios_base::failure("could not open result file " + filename);
+
+        result_file::header h;
+        std::memcpy(h.magic, result_magic, sizeof(h.magic));
+        h.version = result_file::version;
+        h.reserved = 0;
+        h.num_queries = num_queries;
+        _ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+        // otherwise the header only reaches the disk with the first block, and a run
+        // killed before that would leave a file that cannot be resumed
+        _ofs.flush();
+        if (!_ofs.good()) throw std::ios_base::failure("could not write result file " + filename);
+    }
+
+    _buffer.reserve(result_buffer_size);
+    _thread = boost::thread(boost::bind(&ResultFileWriter::thread_main, this));
+}
+
+
+ResultFileWriter::~ResultFileWriter()
+{
+    try {
+        close();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "ResultFileWriter: " << e.what() << std::endl;
+    }
+}
+
+
+void ResultFileWriter::add(uint32_t query, const vector<dist_idx_t>& results)
+{
+    // serialize outside of the lock
+    result_file::record_header r;
+    r.query = query;
+    r.num_results = static_cast<uint32_t>(results.size());
+
+    vector<char> record(sizeof(r) + results.size() * (sizeof(uint32_t) + sizeof(float)));
+    std::memcpy(&record[0], &r, sizeof(r));
+    uint32_t* ids = reinterpret_cast<uint32_t*>(&record[sizeof(r)]);
+    float* scores = reinterpret_cast<float*>(&record[sizeof(r) + results.size() * sizeof(uint32_t)]);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        ids[i] = static_cast<uint32_t>(results[i].second);
+        scores[i] = static_cast<float>(results[i].first);
+    }
+
+    boost::mutex::scoped_lock lock(_mutex);
+
+    _buffer.insert(_buffer.end(), record.begin(), record.end());
+    if (_buffer.size() < result_buffer_size) return;
+
+    // don't let the queries run away from the disk
+    while (_full.size() >= result_max_pending && !_failed) _bufferWritten.wait(lock);
+
+    _full.push_back(vector<char>());
+    _full.back().swap(_buffer);
+    _buffer.reserve(result_buffer_size);
+    _bufferFull.notify_one();
+}
+
+
+void ResultFileWriter::close()
+{
+    if (!_thread.joinable()) return;
+
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        if (!_buffer.empty())
+        {
+            _full.push_back(vector<char>());
+            _full.back().swap(_buffer);
+        }
+        _stop = true;
+        _bufferFull.notify_one();
+    }
+    _thread.join();
+
+    _ofs.close();
+    if (_failed || _ofs.fail()) throw std::ios_base::failure("could not write result file");
+}
+
+
+void ResultFileWriter::thread_main()
+{
+    for (;;)
+    {
+        vector<char> block;
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            while (_full.empty() && !_stop) _bufferFull.wait(lock);
+            if (_full.empty()) break;
+
+            block.swap(_full.front());
+            _full.pop_front();
+        }
+
+        // after an error the remaining records are dropped, close() reports it
+        if (!_failed)
+        {
+            _ofs.write(&block[0], block.size());
+        }
+
+        boost::mutex::scoped_lock lock(_mutex);
+        if (!_ofs.good()) _failed = true;
+        _bufferWritten.notify_all();
+    }
+
+    _ofs.flush();
+    if (!_ofs.good()) _failed = true;
+}
+
+
+void ResultFileWriter::truncate(const string& filename, uint64_t size)
+{
+    const string tmp = filename + ".tmp";
+    {
+        std::ifstream in(filename.c_str(), std::ifstream::binary);
+        std::ofstream out(tmp.c_str(), std::ofstream::binary | std::ofstream::trunc);
+        if (!in.is_open() || !out.is_open()) throw std::ios_base::failure("could not truncate result file " + filename);
+
+        vector<char> block(result_buffer_size);
+        while (size > 0)
+        {
+            const std::streamsize n = static_cast<std::streamsize>(std::min<uint64_t>(size, block.size()));
+            in.read(&block[0], n);
+            out.write(&block[0], n);
+            size -= n;
+        }
+        if (!in.good() || !out.good()) throw std::ios_base::failure("could not truncate result file " + filename);
+    }
+
+    if (std::remove(filename.c_str()) != 0 || std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        throw std::ios_base::failure("could not replace result file " + filename);
+    }
+}
+
+} // end namespace imdb
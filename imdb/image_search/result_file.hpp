@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef RESULT_FILE_HPP
+#define RESULT_FILE_HPP
+
+#include <fstream>
+#include <deque>
+
+#include <boost/utility.hpp>
+#include <boost/thread.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @addtogroup io
+ * @{
+ */
+
+/**
+ * @brief Layout of a binary result file as written by ResultFileWriter.
+ *
+ * The results of all queries of a batch are stored in a single file instead of one text file per query:
+ * -# a header: magic bytes, format version and the number of queries of the batch
+ * -# one record per finished query, in the order the queries finished: query index, number of results n,
+ *    followed by the n document ids and then the n scores (as float).
+ *
+ * Records are only ever appended, so the file of an interrupted batch contains a sequence of complete
+ * records, possibly followed by a truncated one, which is ignored by the reader.
+ */
+namespace result_file
+{
+    /// if you change the internal format, be sure to also adapt reader and writer
+    static const uint32_t version = 1;
+
+    struct header
+    {
+        char     magic[8];      // "IMDBRSLT"
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t num_queries;
+    };
+
+    struct record_header
+    {
+        uint32_t query;
+        uint32_t num_results;
+    };
+}
+
+
+/**
+ * @brief Reads the records of a binary result file one after another, see result_file.
+ */
+class ResultFileReader : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Opens the file and reads its header
+     * @throw std::ios_base::failure if the file cannot be opened, std::runtime_error if it is not a result file
+     */
+    ResultFileReader(const string& filename);
+
+    /// Number of queries of the batch the file was written for
+    uint64_t num_queries() const {return _header.num_queries;}
+
+    /**
+     * @brief Reads the next record.
+     * @param query Index of the query in the query filelist
+     * @param results Results of the query in order of descending similarity
+     * @return false at the end of the file or if the remaining record is truncated
+     */
+    bool next(uint32_t& query, vector<dist_idx_t>& results);
+
+    /// Offset behind the last record successfully read by next()
+    uint64_t valid_size() const {return _validSize;}
+
+private:
+
+    std::ifstream       _ifs;
+    result_file::header _header;
+    uint64_t            _validSize;
+    vec_u32_t           _ids;
+    vec_f32_t           _scores;
+};
+
+
+/**
+ * @brief Appends the results of queries to a binary result file using a background thread.
+ *
+ * add() only serializes the results into an in-memory buffer. Full buffers are written by a separate
+ * thread in large blocks, so the threads running the queries never wait for the disk unless the
+ * writer falls behind by more than a few buffers.
+ */
+class ResultFileWriter : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Opens the file and starts the writer thread.
+     *
+     * If \p resume is true and the file exists, its complete records are kept (a truncated record at the
+     * end is dropped) and new records are appended, see finished(). Otherwise, or if the existing file is
+     * too short to contain a header, the file is overwritten.
+     * @param filename Result file
+     * @param num_queries Number of queries in the query filelist, must match the file when resuming
+     * @param resume Continue an existing file instead of overwriting it
+     * @throw std::ios_base::failure if the file cannot be opened, std::runtime_error if the existing file
+     * does not match
+     */
+    ResultFileWriter(const string& filename, uint64_t num_queries, bool resume);
+
+    /// Calls close(), errors are only reported on the console
+    ~ResultFileWriter();
+
+    /// Queries whose records were already in the file when it was opened with resume=true
+    const vector<uint32_t>& finished() const {return _finished;}
+
+    /// Serializes the results of a query, may be called concurrently
+    void add(uint32_t query, const vector<dist_idx_t>& results);
+
+    /**
+     * @brief Writes all pending records, stops the writer thread and closes the file.
+     * @throw std::ios_base::failure if writing failed
+     */
+    void close();
+
+private:
+
+    void thread_main();
+
+    // copies the complete records of a damaged file to a new file
+    static void truncate(const string& filename, uint64_t size);
+
+    std::ofstream                   _ofs;
+    vector<uint32_t>                _finished;
+
+    // buffer being filled by add() and full buffers waiting for the writer thread
+    vector<char>                    _buffer;
+    std::deque<vector<char> >       _full;
+    bool                            _stop;
+    bool                            _failed;
+
+    boost::mutex                    _mutex;
+    boost::condition_variable       _bufferFull;
+    boost::condition_variable       _bufferWritten;
+    boost::thread                   _thread;
+};
+
+/** @} */
+
+} // end namespace imdb
+
+#endif // RESULT_FILE_HPP
@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef SEARCH_PROTOCOL_HPP
+#define SEARCH_PROTOCOL_HPP
+
+#include <boost/static_assert.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Binary protocol spoken between SearchServer and its clients.
+ *
+ * A client sends any number of requests over a single connection, each request is answered by
+ * exactly one response before the next request is read. All integers are sent in the byte order
+ * of the server (little endian on x86).
+ *
+ * Request: request_header followed by payload_size bytes of payload
+ * - QueryImageData: the payload is an encoded image (any format cv::imdecode() understands, e.g. png/jpg)
+ * - QueryImageFile: the payload is the path of an image file (without terminating 0) readable by the server
+ * - QueryDocument: the payload is the index (uint32_t) of a document of the searched collection, whose stored
+ *   descriptor is used as the query instead of extracting features, see ImageSearcher::query_document()
+ * - Reload: loads a new index (and vocabulary/filelist) while the server keeps answering queries, see
+ *   SearchServer::reload(). The payload is empty to reload the same files, or a JSON object with any of
+ *   the keys "search_params" (object replacing the search manager parameters, e.g. a new "index_file"),
+ *   "vocabulary" and "filelist". The response is sent once the new index is in use
+ *
+ * Response: response_header followed by payload_size bytes of payload
+ * - StatusOk: num_results entries, each a result_entry followed by name_size bytes of the filename of
+ *   the result (relative to the root of the searched filelist)
+ * - StatusTruncated: as StatusOk, but the query ran out of the deadline of the server and the results are
+ *   the best ones found within it (e.g. only the highest weighted query terms were scored)
+ * - StatusError: the payload is an error message
+ * - Reload: StatusOk or StatusError, the payload is a message
+ */
+namespace protocol {
+
+    /// "IMDQ", first four bytes of every request and response
+    const uint32_t magic = 0x51444d49;
+
+    /// Largest accepted request payload (64MB)
+    const uint32_t max_payload_size = 64 * 1024 * 1024;
+
+    enum request_type
+    {
+        QueryImageData = 1,
+        QueryImageFile = 2,
+        Reload         = 3,
+        QueryDocument  = 4
+    };
+
+    enum response_status
+    {
+        StatusOk        = 0,
+        StatusError     = 1,
+        StatusTruncated = 2
+    };
+
+    struct request_header
+    {
+        uint32_t magic;
+        uint32_t type;          // request_type
+        uint32_t num_results;   // number of results requested
+        uint32_t payload_size;
+    };
+
+    struct response_header
+    {
+        uint32_t magic;
+        uint32_t status;        // response_status
+        uint32_t num_results;   // number of result entries in the payload
+        uint32_t payload_size;
+    };
+
+    struct result_entry
+    {
+        double   score;         // distance or similarity, as returned by the search manager
+        uint32_t id;            // index of the result in the searched filelist
+        uint32_t name_size;     // length of the filename following this entry
+    };
+
+    BOOST_STATIC_ASSERT(sizeof(request_header) == 16);
+    BOOST_STATIC_ASSERT(sizeof(response_header) == 16);
+    BOOST_STATIC_ASSERT(sizeof(result_entry) == 16);
+
+} // end namespace protocol
+
+} // end namespace imdb
+
+#endif // SEARCH_PROTOCOL_HPP
@@ -0,0 +1,383 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "search_server.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <opencv2/highgui/highgui.hpp>
+
+namespace imdb {
+
+namespace {
+
+void append(vector<char>& buffer, const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+    buffer.insert(buffer.end(), p, p + size);
+}
+
+void error_response(const string& message, protocol::response_header& response, vector<char>& response_payload)
+{
+    response.status = protocol::StatusError;
+    response.num_results = 0;
+    response_payload.assign(message.begin(), message.end());
+    response.payload_size = static_cast<uint32_t>(response_payload.size());
+}
+
+} // end anonymous namespace
+
+
+SearchServer::SearchServer(shared_ptr<Generator> generator, const search_source& source, size_t max_batch_size, int batch_window_ms,
+                           double deadline_ms)
+    : _generator(generator)
+    , _maxBatchSize(max_batch_size)
+    , _batchWindowMs(batch_window_ms)
+    , _deadlineMs(deadline_ms)
+{
+    if (max_batch_size > 1)
+    {
+        std::cout << "SearchServer: batching up to " << max_batch_size << " queries within " << batch_window_ms << "ms" << std::endl;
+    }
+    if (deadline_ms > 0)
+    {
+        if (max_batch_size > 1) std::cout << "SearchServer: warning: the deadline only applies to queries that are not batched (batchsize 1)" << std::endl;
+        else std::cout << "SearchServer: deadline of " << deadline_ms << "ms per query" << std::endl;
+    }
+
+    _current = load(source, 1);
+}
+
+
+SearchServer::generation::~generation()
+{
+    // the scheduler refers to the searcher, stop it first
+    scheduler.reset();
+    searcher.reset();
+    std::cout << "SearchServer: released index generation " << id << std::endl;
+}
+
+
+shared_ptr<SearchServer::generation> SearchServer::load(const search_source& source, size_t id) const
+{
+    std::cout << "SearchServer: loading index generation " << id << std::endl;
+
+    shared_ptr<generation> g(new generation());
+    g->id = id;
+    g->source = source;
+
+    try {
+        g->files.load(source.filelist_file);
+        g->searcher.reset(new ImageSearcher(_generator, source.search_params, source.vocabulary_file));
+    }
+    catch (const std::exception& e)
+    {
+        throw std::runtime_error("could not load index generation " + boost::lexical_cast<string>(id) + ": " + e.what());
+    }
+
+    // results are looked up in the file list, it must cover exactly the documents of the index
+    if (g->files.size() != g->searcher->num_documents())
+    {
+        throw std::runtime_error("could not load index generation " + boost::lexical_cast<string>(id) + ": " + source.filelist_file + " lists "
+                                 + boost::lexical_cast<string>(g->files.size()) + " files, but the index has "
+                                 + boost::lexical_cast<string>(g->searcher->num_documents()) + " documents");
+    }
+
+    if (_maxBatchSize > 1) g->scheduler.reset(new QueryScheduler(*g->searcher, _maxBatchSize, _batchWindowMs));
+
+    std::cout << "SearchServer: index generation " << id << " loaded, " << g->files.size() << " files" << std::endl;
+    return g;
+}
+
+
+shared_ptr<SearchServer::generation> SearchServer::current() const
+{
+    boost::mutex::scoped_lock lock(_currentMutex);
+    return _current;
+}
+
+
+void SearchServer::reload(const search_source& source)
+{
+    boost::mutex::scoped_lock reloadLock(_reloadMutex);
+
+    // loading takes long, the current generation keeps serving meanwhile
+    shared_ptr<generation> next = load(source, current()->id + 1);
+
+    shared_ptr<generation> previous;
+    {
+        boost::mutex::scoped_lock lock(_currentMutex);
+        previous = _current;
+        _current = next;
+    }
+
+    std::cout << "SearchServer: switched to index generation " << next->id
+              << ", generation " << previous->id << " is released once its queries are done" << std::endl;
+}
+
+
+search_source SearchServer::source() const
+{
+    return current()->source;
+}
+
+
+void SearchServer::run(const string& endpoint)
+{
+    using namespace boost::asio;
+
+    try {
+        if (!endpoint.empty() && boost::algorithm::all(endpoint, boost::algorithm::is_digit()))
+        {
+            std::cout << "SearchServer: listening on 127.0.0.1:" << endpoint << std::endl;
+            accept_loop<ip::tcp>(ip::tcp::endpoint(ip::address_v4::loopback(), boost::lexical_cast<unsigned short>(endpoint)));
+        }
+        else
+        {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+            // a socket file left over by a previous run would make bind() fail
+            std::remove(endpoint.c_str());
+            std::cout << "SearchServer: listening on " << endpoint << std::endl;
+            accept_loop<local::stream_protocol>(local::stream_protocol::endpoint(endpoint));
+#else
+            throw std::runtime_error("Unix domain sockets are not supported on this platform, pass a TCP port instead");
+#endif
+        }
+    }
+    catch (const boost::system::system_error& e)
+    {
+        throw std::runtime_error("could not open endpoint " + endpoint + ": " + e.what());
+    }
+}
+
+
+template <class protocol_t>
+void SearchServer::accept_loop(const typename protocol_t::endpoint& endpoint)
+{
+    typedef typename protocol_t::socket socket_t;
+
+    boost::asio::io_service io_service;
+    typename protocol_t::acceptor acceptor(io_service, endpoint);
+
+    for (;;)
+    {
+        shared_ptr<socket_t> socket(new socket_t(io_service));
+        acceptor.accept(*socket);
+
+        boost::thread worker(boost::bind(&SearchServer::serve_connection<socket_t>, this, socket));
+        worker.detach();
+    }
+}
+
+
+template <class socket_t>
+void SearchServer::serve_connection(shared_ptr<socket_t> socket)
+{
+    vector<char> payload;
+    vector<char> responsePayload;
+
+    // serve requests until the client closes the connection or sends garbage
+    for (;;)
+    {
+        boost::system::error_code error;
+
+        protocol::request_header header;
+        boost::asio::read(*socket, boost::asio::buffer(&header, sizeof(header)), error);
+        if (error) break;
+
+        if (header.magic != protocol::magic || header.payload_size > protocol::max_payload_size)
+        {
+            std::cerr << "SearchServer: invalid request, closing connection" << std::endl;
+            break;
+        }
+
+        payload.resize(header.payload_size);
+        if (!payload.empty()) boost::asio::read(*socket, boost::asio::buffer(payload), error);
+        if (error) break;
+
+        // a request the server cannot handle (e.g. an image that makes the decoder throw)
+        // is answered with an error, it must neither end this thread nor the server
+        protocol::response_header response;
+        try {
+            handle(header, payload, response, responsePayload);
+        }
+        catch (const std::exception& e)
+        {
+            error_response(string("request failed: ") + e.what(), response, responsePayload);
+        }
+
+        boost::asio::write(*socket, boost::asio::buffer(&response, sizeof(response)), error);
+        if (!error && !responsePayload.empty()) boost::asio::write(*socket, boost::asio::buffer(responsePayload), error);
+        if (error) break;
+    }
+
+    boost::system::error_code ignored;
+    socket->close(ignored);
+}
+
+
+void SearchServer::handle(const protocol::request_header& header, const vector<char>& payload,
+                          protocol::response_header& response, vector<char>& response_payload)
+{
+    response.magic = protocol::magic;
+    response_payload.clear();
+
+    if (header.type == protocol::Reload) handle_reload(payload, response, response_payload);
+    else handle_query(header, payload, response, response_payload);
+}
+
+
+void SearchServer::handle_query(const protocol::request_header& header, const vector<char>& payload,
+                                protocol::response_header& response, vector<char>& response_payload) const
+{
+    // decoding the image counts against the budget as well
+    const Deadline deadline = Deadline::in_ms(_deadlineMs);
+
+    if (header.type == protocol::QueryDocument)
+    {
+        handle_query_document(header, payload, deadline, response, response_payload);
+        return;
+    }
+
+    mat_8uc3_t image;
+    if (header.type == protocol::QueryImageData)
+    {
+        if (!payload.empty()) image = cv::imdecode(payload, 1);
+    }
+    else if (header.type == protocol::QueryImageFile)
+    {
+        image = cv::imread(string(payload.begin(), payload.end()), 1);
+    }
+    else
+    {
+        error_response("unknown request type " + boost::lexical_cast<string>(header.type), response, response_payload);
+        return;
+    }
+
+    if (image.empty())
+    {
+        error_response("could not decode query image", response, response_payload);
+        return;
+    }
+
+    // keeps the generation alive until the query is done, even if a reload switches to a new one meanwhile
+    shared_ptr<generation> g = current();
+
+    vector<dist_idx_t> results;
+    bool complete = true;
+    try {
+        if (g->scheduler) g->scheduler->query(image, header.num_results, results);
+        else complete = g->searcher->query(image, header.num_results, results, 0, deadline);
+    }
+    catch (const std::exception& e)
+    {
+        error_response(string("query failed: ") + e.what(), response, response_payload);
+        return;
+    }
+
+    result_response(*g, results, complete, response, response_payload);
+}
+
+
+void SearchServer::handle_query_document(const protocol::request_header& header, const vector<char>& payload, const Deadline& deadline,
+                                         protocol::response_header& response, vector<char>& response_payload) const
+{
+    uint32_t document;
+    if (payload.size() != sizeof(document))
+    {
+        error_response("the payload of a query by document must be its 4 byte index", response, response_payload);
+        return;
+    }
+    std::memcpy(&document, &payload[0], sizeof(document));
+
+    // keeps the generation alive until the query is done, even if a reload switches to a new one meanwhile
+    shared_ptr<generation> g = current();
+
+    // the stored descriptor is searched directly, there is no feature
+    // extraction that batching with other queries could share
+    vector<dist_idx_t> results;
+    bool complete = true;
+    try {
+        complete = g->searcher->query_document(document, header.num_results, results, 0, deadline);
+    }
+    catch (const std::exception& e)
+    {
+        error_response(string("query failed: ") + e.what(), response, response_payload);
+        return;
+    }
+
+    result_response(*g, results, complete, response, response_payload);
+}
+
+
+void SearchServer::result_response(const generation& g, const vector<dist_idx_t>& results, bool complete,
+                                   protocol::response_header& response, vector<char>& response_payload) const
+{
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const string& filename = g.files.get_relative_filename(results[i].second);
+
+        protocol::result_entry entry;
+        entry.score = results[i].first;
+        entry.id = static_cast<uint32_t>(results[i].second);
+        entry.name_size = static_cast<uint32_t>(filename.size());
+        append(response_payload, &entry, sizeof(entry));
+        append(response_payload, filename.data(), filename.size());
+    }
+
+    response.status = complete ? protocol::StatusOk : protocol::StatusTruncated;
+    response.num_results = static_cast<uint32_t>(results.size());
+    response.payload_size = static_cast<uint32_t>(response_payload.size());
+}
+
+
+void SearchServer::handle_reload(const vector<char>& payload, protocol::response_header& response, vector<char>& response_payload)
+{
+    // keys missing from the request keep their current value
+    search_source next = source();
+    try {
+        if (!payload.empty())
+        {
+            ptree request;
+            std::istringstream stream(string(payload.begin(), payload.end()));
+            boost::property_tree::read_json(stream, request);
+
+            boost::optional<ptree&> search_params = request.get_child_optional("search_params");
+            if (search_params) next.search_params = *search_params;
+            next.vocabulary_file = request.get<string>("vocabulary", next.vocabulary_file);
+            next.filelist_file = request.get<string>("filelist", next.filelist_file);
+        }
+
+        reload(next);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "SearchServer: reload failed: " << e.what() << std::endl;
+        error_response(string("reload failed: ") + e.what(), response, response_payload);
+        return;
+    }
+
+    const string message = "index generation " + boost::lexical_cast<string>(current()->id) + " in use";
+    response.status = protocol::StatusOk;
+    response.num_results = 0;
+    response_payload.assign(message.begin(), message.end());
+    response.payload_size = static_cast<uint32_t>(response_payload.size());
+}
+
+} // end namespace imdb
@@ -0,0 +1,160 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef SEARCH_SERVER_HPP
+#define SEARCH_SERVER_HPP
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+#include "filelist.hpp"
+#include "generator.hpp"
+#include "image_searcher.hpp"
+#include "search_protocol.hpp"
+#include "query_scheduler.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Files an ImageSearcher and the filelist of the searched collection are loaded from.
+ */
+struct search_source
+{
+    /// Parameters of the search manager, see ImageSearcher
+    ptree  search_params;
+
+    /// Vocabulary used for quantization, only required for bag-of-features search
+    string vocabulary_file;
+
+    /// Filelist of the searched collection, used to report the filenames of the results
+    string filelist_file;
+};
+
+
+/**
+ * @ingroup search
+ * @brief Long running server answering image queries, see protocol for the wire format.
+ *
+ * All datastructures (generator, vocabulary, index) are loaded once, so the latency of a query is only
+ * that of the feature extraction and the search itself. Each client connection is served by its own
+ * thread, queries of different connections run concurrently. Optionally, concurrent queries are
+ * collected into small batches by a QueryScheduler to increase the throughput under load.
+ *
+ * The searcher and filelist in use form a generation. reload() loads a new generation (e.g. a rebuilt
+ * index) while the current one keeps answering queries, and then atomically switches all new queries to
+ * it. Queries in flight hold a reference to the generation they started on and finish on it, the old
+ * generation is released when its last query is done. Note that both generations are in memory while
+ * loading.
+ *
+ * The server listens on a Unix domain socket where the platform supports them. An endpoint consisting of
+ * digits only is taken as a TCP port on the loopback interface instead (e.g. on Windows).
+ */
+class SearchServer : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Loads the first generation.
+     * @param generator Generator used for extracting the features of query images, shared by all generations
+     * @param source Files of the first generation
+     * @param max_batch_size [optional] if > 1, concurrent queries are run in batches of up to this size, see QueryScheduler
+     * @param batch_window_ms [optional] maximum time a query waits for further queries to share its batch
+     * @param deadline_ms [optional] if > 0, time budget of each query counted from its receipt, queries running out of it
+     * are answered with the best results found so far and protocol::StatusTruncated. Batched queries have no deadline.
+     * @throw std::runtime_error if the searcher cannot be loaded
+     */
+    SearchServer(shared_ptr<Generator> generator, const search_source& source, size_t max_batch_size = 1, int batch_window_ms = 0,
+                 double deadline_ms = 0);
+
+    /**
+     * @brief Accepts and serves connections until the process is terminated.
+     * @param endpoint Path of the Unix domain socket (an existing file at this path is removed) or a TCP port
+     * @throw std::runtime_error if the endpoint cannot be opened
+     */
+    void run(const string& endpoint);
+
+    /**
+     * @brief Answers a single request, also used by run() for each request received.
+     * @param header Header of the request
+     * @param payload Payload of the request
+     * @param response Header of the response
+     * @param response_payload Payload of the response
+     */
+    void handle(const protocol::request_header& header, const vector<char>& payload,
+                protocol::response_header& response, vector<char>& response_payload);
+
+    /**
+     * @brief Loads a new generation and switches all new queries to it once it is complete.
+     *
+     * Queries keep being answered by the current generation while loading. Only one reload runs at a
+     * time, concurrent calls wait for each other.
+     * @param source Files of the new generation
+     * @throw std::runtime_error if loading fails or the file list does not match the number of documents
+     * searched, the current generation then stays in use
+     */
+    void reload(const search_source& source);
+
+    /// Files of the generation currently in use
+    search_source source() const;
+
+private:
+
+    // everything needed to answer a query, shared by all queries running on it
+    struct generation
+    {
+        ~generation();
+
+        size_t                     id;
+        search_source              source;
+        shared_ptr<ImageSearcher>  searcher;
+        FileList                   files;
+
+        // null if queries are not batched
+        shared_ptr<QueryScheduler> scheduler;
+    };
+
+    shared_ptr<generation> load(const search_source& source, size_t id) const;
+
+    // the generation new queries run on
+    shared_ptr<generation> current() const;
+
+    void handle_query(const protocol::request_header& header, const vector<char>& payload,
+                      protocol::response_header& response, vector<char>& response_payload) const;
+
+    void handle_query_document(const protocol::request_header& header, const vector<char>& payload, const Deadline& deadline,
+                               protocol::response_header& response, vector<char>& response_payload) const;
+
+    // serializes the results of a query into the response
+    void result_response(const generation& g, const vector<dist_idx_t>& results, bool complete,
+                         protocol::response_header& response, vector<char>& response_payload) const;
+
+    void handle_reload(const vector<char>& payload, protocol::response_header& response, vector<char>& response_payload);
+
+    template <class protocol_t>
+    void accept_loop(const typename protocol_t::endpoint& endpoint);
+
+    template <class socket_t>
+    void serve_connection(shared_ptr<socket_t> socket);
+
+    shared_ptr<Generator>  _generator;
+    size_t                 _maxBatchSize;
+    int                    _batchWindowMs;
+    double                 _deadlineMs;
+
+    shared_ptr<generation> _current;
+    mutable boost::mutex   _currentMutex;
+
+    // serializes reloads
+    boost::mutex           _reloadMutex;
+};
+
+} // end namespace imdb
+
+#endif // SEARCH_SERVER_HPP
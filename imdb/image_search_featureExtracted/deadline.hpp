@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef DEADLINE_HPP
+#define DEADLINE_HPP
+
+#include <boost/chrono.hpp>
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Point in time by which a query should be answered.
+ *
+ * Stages of the query path that can trade accuracy for time (quantizing only part of the samples,
+ * scanning only the posting lists of the highest weighted terms, scanning only part of the features in
+ * linear search) check expired() between units of work and return the best results found so far once
+ * the deadline has passed. A default constructed Deadline never expires.
+ */
+class Deadline
+{
+public:
+
+    typedef boost::chrono::steady_clock clock;
+
+    /// No deadline, expired() is always false
+    Deadline() : _limited(false) {}
+
+    /// Deadline \p ms milliseconds from now, no deadline if \p ms <= 0
+    static Deadline in_ms(double ms)
+    {
+        Deadline d;
+        if (ms > 0)
+        {
+            d._limited = true;
+            d._at = clock::now() + boost::chrono::duration_cast<clock::duration>(boost::chrono::duration<double, boost::milli>(ms));
+        }
+        return d;
+    }
+
+    /// False if this deadline never expires
+    bool limited() const {return _limited;}
+
+    /// True once the deadline has passed
+    bool expired() const {return _limited && clock::now() >= _at;}
+
+private:
+
+    bool              _limited;
+    clock::time_point _at;
+};
+
+} // end namespace imdb
+
+#endif // DEADLINE_HPP
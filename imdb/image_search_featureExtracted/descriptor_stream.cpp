@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "descriptor_stream.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+
+#include <boost/bind.hpp>
+
+namespace imdb {
+
+DescriptorStream::DescriptorStream(const string& filename, size_t max_pending)
+    : _reader(filename)
+    , _maxPending(std::max<size_t>(1, max_pending))
+    , _done(false)
+    , _stop(false)
+{}
+
+
+DescriptorStream::~DescriptorStream()
+{
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _stop = true;
+        _elementTaken.notify_all();
+    }
+    if (_thread.joinable()) _thread.join();
+}
+
+
+void DescriptorStream::start(const vector<index_t>& indices)
+{
+    assert(!_thread.joinable());
+
+    _indices = indices;
+    _thread = boost::thread(boost::bind(&DescriptorStream::thread_main, this));
+}
+
+
+bool DescriptorStream::next(index_t& index, vec_vec_f32_t& features)
+{
+    boost::mutex::scoped_lock lock(_mutex);
+    while (_pending.empty() && !_done) _elementRead.wait(lock);
+
+    if (_pending.empty())
+    {
+        if (!_error.empty()) throw std::runtime_error(_error);
+        return false;
+    }
+
+    index = _pending.front().first;
+    features.swap(_pending.front().second);
+    _pending.pop_front();
+    _elementTaken.notify_one();
+    return true;
+}
+
+
+void DescriptorStream::thread_main()
+{
+    try {
+        for (size_t i = 0; i < _indices.size(); i++)
+        {
+            if (_indices[i] < 0 || _indices[i] >= _reader.size()) throw std::runtime_error("DescriptorStream: index out of range");
+
+            // read outside of the lock, only this thread uses the reader
+            std::pair<index_t, vec_vec_f32_t> element;
+            element.first = _indices[i];
+            _reader.get(element.second, _indices[i]);
+
+            boost::mutex::scoped_lock lock(_mutex);
+            while (_pending.size() >= _maxPending && !_stop) _elementTaken.wait(lock);
+            if (_stop) break;
+
+            _pending.push_back(std::pair<index_t, vec_vec_f32_t>());
+            _pending.back().first = element.first;
+            _pending.back().second.swap(element.second);
+            _elementRead.notify_one();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        boost::mutex::scoped_lock lock(_mutex);
+        _error = e.what();
+    }
+
+    boost::mutex::scoped_lock lock(_mutex);
+    _done = true;
+    _elementRead.notify_all();
+}
+
+} // end namespace imdb
@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef DESCRIPTOR_STREAM_HPP
+#define DESCRIPTOR_STREAM_HPP
+
+#include <deque>
+
+#include <boost/utility.hpp>
+#include <boost/thread.hpp>
+
+#include "types.hpp"
+#include "property_reader.hpp"
+
+namespace imdb {
+
+/**
+ * @addtogroup io
+ * @{
+ */
+
+/**
+ * @brief Reads the local features of a set of queries from a property file on a background thread.
+ *
+ * The selected elements are read in ascending order, i.e. sequentially through the file, and kept in a
+ * bounded queue, such that the threads consuming them (e.g. quantizing and scoring the queries) never
+ * wait for the disk unless they are faster than it. next() may be called concurrently by any number of
+ * threads.
+ */
+class DescriptorStream : public boost::noncopyable
+{
+public:
+
+    /**
+     * @brief Opens the file, reading starts with start().
+     * @param filename Property file of vec_vec_f32_t, one element per query
+     * @param max_pending Maximum number of elements read ahead
+     * @throw std::runtime_error if the file cannot be opened or is of a different type
+     */
+    DescriptorStream(const string& filename, size_t max_pending = 64);
+
+    /// Stops the reader thread, elements not taken yet are dropped
+    ~DescriptorStream();
+
+    /// Number of elements in the file
+    index_t size() const {return _reader.size();}
+
+    /**
+     * @brief Starts reading the given elements on the background thread, may only be called once.
+     * @param indices Indices of the elements to read, in ascending order
+     */
+    void start(const vector<index_t>& indices);
+
+    /**
+     * @brief Takes the next element, waits until it has been read.
+     * @param index Index of the element in the file
+     * @param features The element
+     * @return false once all elements have been taken
+     * @throw std::runtime_error if reading failed
+     */
+    bool next(index_t& index, vec_vec_f32_t& features);
+
+private:
+
+    void thread_main();
+
+    PropertyReaderT<vec_vec_f32_t>                       _reader;
+    size_t                                               _maxPending;
+    vector<index_t>                                      _indices;
+
+    std::deque<std::pair<index_t, vec_vec_f32_t> >       _pending;
+    bool                                                 _done;
+    bool                                                 _stop;
+    string                                               _error;
+
+    boost::mutex                                         _mutex;
+    boost::condition_variable                            _elementRead;
+    boost::condition_variable                            _elementTaken;
+    boost::thread                                        _thread;
+};
+
+/** @} */
+
+} // end namespace imdb
+
+#endif // DESCRIPTOR_STREAM_HPP
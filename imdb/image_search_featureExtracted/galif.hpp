@@ -50,6 +50,7 @@ class galif_generator : public Generator
     const bool         _smoothHist;
     const string       _normalizeHist;
     const string       _samplerName;
+    const bool         _parallel;
 
     cv::Size _filterSize;
     vector<cv::Mat_<std::complex<double> > > _gaborFilter;
@@ -0,0 +1,208 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "index_file.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include <boost/crc.hpp>
+#include <boost/static_assert.hpp>
+
+namespace imdb {
+
+// header and table of contents are written as raw structs, make
+// sure that they have no compiler dependent padding
+BOOST_STATIC_ASSERT(sizeof(index_file::header) == 16);
+BOOST_STATIC_ASSERT(sizeof(index_file::section_info) == 32);
+
+static const char index_magic[8] = { 'I', 'M', 'D', 'B', 'I', 'N', 'D', 'X' };
+
+namespace index_file
+{
+    bool is_sectioned(const string& filename)
+    {
+        std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+        char magic[8] = { 0 };
+        ifs.read(magic, sizeof(magic));
+        return ifs.good() && std::memcmp(magic, index_magic, sizeof(magic)) == 0;
+    }
+
+    uint32_t checksum(const void* data, uint64_t size)
+    {
+        boost::crc_32_type crc;
+        crc.process_bytes(data, size);
+        return crc.checksum();
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+
+void IndexFileWriter::add(uint32_t id, uint32_t element_size, const void* data, uint64_t size)
+{
+    for (size_t i = 0; i < _sections.size(); i++)
+    {
+        if (_sections[i].info.id == id) throw std::runtime_error("IndexFileWriter: section " + boost::lexical_cast<string>(id) + " added twice");
+    }
+
+    pending_section s;
+    std::memset(&s.info, 0, sizeof(s.info));
+    s.info.id = id;
+    s.info.element_size = element_size;
+    s.info.size = size;
+    s.info.checksum = index_file::checksum(data, size);
+    s.data = static_cast<const char*>(data);
+    _sections.push_back(s);
+}
+
+
+void IndexFileWriter::write(const string& filename) const
+{
+    using namespace index_file;
+
+    std::ofstream ofs;
+
+    // make ofstream thrown exception when the failbit gets set
+    ofs.exceptions(std::ios::failbit);
+
+    try { ofs.open(filename.c_str(), std::ios::out | std::ios::binary); }
+
+    // catch and rethrow with the sole purpose of providing a better error message
+    // than the library implementation does, which gives "basic_ios::clear"
+    catch (std::ios_base::failure& e)
+    {
+        throw std::ios_base::failure("could not open file " + filename + " for writing");
+    }
+
+    index_file::header h;
+    std::memcpy(h.magic, index_magic, sizeof(h.magic));
+    h.version = index_file::version;
+    h.num_sections = static_cast<uint32_t>(_sections.size());
+
+    // compute the aligned position of each section behind header and table of contents
+    vector<section_info> toc(_sections.size());
+    uint64_t offset = align(sizeof(h) + toc.size() * sizeof(section_info));
+    for (size_t i = 0; i < _sections.size(); i++)
+    {
+        toc[i] = _sections[i].info;
+        toc[i].offset = offset;
+        offset = align(offset + toc[i].size);
+    }
+
+    ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    if (!toc.empty()) ofs.write(reinterpret_cast<const char*>(&toc[0]), toc.size() * sizeof(section_info));
+
+    static const char padding[alignment] = { 0 };
+    uint64_t position = sizeof(h) + toc.size() * sizeof(section_info);
+    for (size_t i = 0; i < toc.size(); i++)
+    {
+        ofs.write(padding, toc[i].offset - position);
+        if (toc[i].size) ofs.write(_sections[i].data, toc[i].size);
+        position = toc[i].offset + toc[i].size;
+    }
+
+    // pad the file such that the last section also ends on an aligned offset
+    ofs.write(padding, align(position) - position);
+    ofs.close();
+}
+
+
+IndexFileReader::IndexFileReader(const string& filename)
+    : _filename(filename)
+    , _ifs(filename.c_str(), std::ios::in | std::ios::binary)
+{
+    if (!_ifs.is_open()) throw std::runtime_error("could not open file " + filename);
+
+    index_file::header h;
+    _ifs.read(reinterpret_cast<char*>(&h), sizeof(h));
+    if (!_ifs.good() || std::memcmp(h.magic, index_magic, sizeof(h.magic)) != 0)
+    {
+        throw std::runtime_error("file " + filename + " is not a sectioned index file");
+    }
+
+    if (h.version != index_file::version)
+    {
+        throw std::runtime_error("version of file " + filename + " is different from program version");
+    }
+
+    _sections.resize(h.num_sections);
+    if (h.num_sections) _ifs.read(reinterpret_cast<char*>(&_sections[0]), h.num_sections * sizeof(index_file::section_info));
+    if (!_ifs.good()) throw std::runtime_error("error while reading table of contents of file " + filename);
+}
+
+
+bool IndexFileReader::has_section(uint32_t id) const
+{
+    for (size_t i = 0; i < _sections.size(); i++)
+    {
+        if (_sections[i].id == id) return true;
+    }
+    return false;
+}
+
+
+const index_file::section_info& IndexFileReader::section(uint32_t id) const
+{
+    for (size_t i = 0; i < _sections.size(); i++)
+    {
+        if (_sections[i].id == id) return _sections[i];
+    }
+    throw std::runtime_error("file " + _filename + " does not contain section " + boost::lexical_cast<string>(id));
+}
+
+
+void IndexFileReader::read(const index_file::section_info& info, void* data, bool verify)
+{
+    _ifs.seekg(info.offset);
+    if (info.size) _ifs.read(static_cast<char*>(data), info.size);
+    if (!_ifs.good()) throw std::runtime_error("error while reading section " + boost::lexical_cast<string>(info.id) + " of file " + _filename);
+
+    if (verify && index_file::checksum(data, info.size) != info.checksum)
+    {
+        throw std::runtime_error("checksum mismatch in section " + boost::lexical_cast<string>(info.id) + " of file " + _filename + ", the file is corrupt");
+    }
+}
+
+
+void IndexFileReader::read_range(uint32_t id, uint64_t offset, uint64_t size, void* data)
+{
+    const index_file::section_info& info = section(id);
+    if (offset + size > info.size) throw std::runtime_error("read beyond the end of section " + boost::lexical_cast<string>(id) + " of file " + _filename);
+
+    _ifs.seekg(info.offset + offset);
+    if (size) _ifs.read(static_cast<char*>(data), size);
+    if (!_ifs.good()) throw std::runtime_error("error while reading section " + boost::lexical_cast<string>(id) + " of file " + _filename);
+}
+
+
+bool IndexFileReader::verify(uint32_t id)
+{
+    const index_file::section_info& info = section(id);
+
+    // verify in chunks to keep memory usage low for huge sections
+    static const uint64_t chunk_size = 1 << 24;
+    vector<char> buffer(static_cast<size_t>(std::min(info.size, chunk_size)));
+
+    boost::crc_32_type crc;
+    _ifs.seekg(info.offset);
+    for (uint64_t done = 0; done < info.size; )
+    {
+        uint64_t n = std::min(chunk_size, info.size - done);
+        _ifs.read(&buffer[0], n);
+        if (!_ifs.good()) return false;
+        crc.process_bytes(&buffer[0], n);
+        done += n;
+    }
+    return crc.checksum() == info.checksum;
+}
+
+} // end namespace imdb
@@ -14,15 +14,21 @@ the terms of the BSD license (see the LICENSE file).
 #include <io.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 //util/
 #include "types.hpp"
 #include "quantizer.hpp"
 #include "kmeans.hpp"
 //io/
 #include "property_reader.hpp"
+#include "descriptor_stream.hpp"
 #include "cmdline.hpp"
 #include "filelist.hpp"
 //descriptors/
@@ -41,6 +47,156 @@ the terms of the BSD license (see the LICENSE file).
 
 using namespace imdb;
 
+
+// writes the retrieval list of a query as text, one line per result
+void write_retrieval_list(const FileList& imageFiles, const vector<dist_idx_t>& results, const string& outdir, const string& dir, const string& path)
+{
+#ifdef SHOW_RESULT
+	// output results on the console
+	// use piping to store in a text file (for now)
+	std::cout << "----------------------------" << std::endl;
+	std::cout << "-idx--score--filename-------" << std::endl;
+	std::cout << "----------------------------" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		string filename = imageFiles.get_relative_filename(results[i].second);
+		std::cout.precision(9);
+		std::cout << i << " " << (float)results[i].first << " " << filename << std::endl;
+	}
+#endif // SHOW_RESULT
+
+	// store as csv
+	// mkdir outdir/class, fails harmlessly if another thread was first
+	if (_mkdir(outdir.c_str()) != -1) {
+		printf("\nCreate Dir: %s\n", outdir.c_str());
+	}
+	if (_mkdir(dir.c_str()) != -1) {
+		printf("\nCreate Dir: %s\n", dir.c_str());
+	}
+
+	std::ofstream str;
+	str.open(path.c_str());
+	if (str.is_open()) {
+		for (size_t i = 0; i < results.size(); i++) {
+			string filename = imageFiles.get_relative_filename(results[i].second);
+			std::istringstream sin1(filename);
+			std::getline(sin1, filename, '.');
+#ifdef SAVE_SCORE
+			double score = results[i].first;
+			str << std::to_string(score) << ' ' << filename << '\n';
+#else
+			str << filename << '\n';
+#endif
+		}
+	}
+}
+
+
+// runs the queries read by a DescriptorStream on a pool of threads, each thread
+// quantizes and scores its own queries against the shared vocabulary and index
+class descriptor_search
+{
+public:
+
+	descriptor_search(DescriptorStream& stream, const vec_vec_f32_t& vocabulary, const BofSearchManager& search,
+	                  const FileList& imageFiles, const string& outdir, const vector<string>& dirs, const vector<string>& paths,
+	                  size_t num_results, size_t num_queries)
+		: _stream(stream)
+		, _vocabulary(vocabulary)
+		, _search(search)
+		, _imageFiles(imageFiles)
+		, _outdir(outdir)
+		, _dirs(dirs)
+		, _paths(paths)
+		, _numResults(num_results)
+		, _numQueries(num_queries)
+		, _numThreads(0)
+		, _numFinished(0)
+		, _error(false)
+	{}
+
+	// returns false if a query failed, the remaining queries are not run in that case
+	bool run(int num_threads)
+	{
+		_numThreads = num_threads;
+
+		boost::thread_group pool;
+		for (int i = 0; i < num_threads; i++) pool.add_thread(new boost::thread(boost::bind(&descriptor_search::thread_main, this)));
+		pool.join_all();
+
+		return !_error;
+	}
+
+	size_t num_finished() const { return _numFinished; }
+
+private:
+
+	void thread_main()
+	{
+#ifdef _OPENMP
+		// the pool is the parallelism, don't start a team of threads per query on top
+		if (_numThreads > 1) omp_set_num_threads(1);
+#endif
+
+		quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
+		index_t query = -1;
+		vec_vec_f32_t samples;
+
+		while (!_error)
+		{
+			try {
+				if (!_stream.next(query, samples)) break;
+			}
+			catch (const std::exception& e)
+			{
+				boost::lock_guard<boost::mutex> lock(_mutex);
+				std::cerr << "image_search: reading query descriptors failed: " << e.what() << std::endl;
+				_error = true;
+				return;
+			}
+
+			try {
+				vec_vec_f32_t quantized_samples;
+				quantize_samples_parallel(samples, _vocabulary, quantized_samples, quantizer);
+
+				vec_f32_t histvw;
+				build_histvw(quantized_samples, _vocabulary.size(), histvw, false);
+
+				// run query
+				vector<dist_idx_t> results;
+				_search.query(histvw, _numResults, results);
+
+				write_retrieval_list(_imageFiles, results, _outdir, _dirs[query], _paths[query]);
+			}
+			catch (const std::exception& e)
+			{
+				boost::lock_guard<boost::mutex> lock(_mutex);
+				std::cerr << "image_search: query " << query << " failed: " << e.what() << std::endl;
+				_error = true;
+				return;
+			}
+
+			boost::lock_guard<boost::mutex> lock(_mutex);
+			_numFinished++;
+			std::cout << "image_search: progress " << _numFinished << '/' << _numQueries << std::endl;
+		}
+	}
+
+	DescriptorStream&       _stream;
+	const vec_vec_f32_t&    _vocabulary;
+	const BofSearchManager& _search;
+	const FileList&         _imageFiles;
+	const string&           _outdir;
+	const vector<string>&   _dirs;
+	const vector<string>&   _paths;
+	size_t                  _numResults;
+	size_t                  _numQueries;
+	int                     _numThreads;
+
+	size_t                  _numFinished;
+	volatile bool           _error;
+	boost::mutex            _mutex;
+};
+
 template <class search_t>
 void image_search(const anymap_t& data, const search_t& search, size_t num_results, vector<dist_idx_t>& results)
 {
@@ -68,6 +224,7 @@ public:
         , _co_num_results  ("numresults"      , "n", "number of results to search for [optional, if not provided all distances get computed]")
 		, _co_wkdir("working dir"             , "r", "directory path of the query [required]")
 		, _co_outdir("saving dir"             , "o", "the path of the retrieval list saved in [optional, if not provided, will be set as \"retrieval_list\"]")
+        , _co_numthreads("numthreads"         , "t", "number of threads running queries in parallel [optional] (default: number of processors)")
     {
 		add(_co_descriptor);
         add(_co_query_image);
@@ -80,6 +237,7 @@ public:
         add(_co_generator_name);
 		add(_co_wkdir);
 		add(_co_outdir);
+        add(_co_numthreads);
     }
 
 
@@ -186,9 +344,15 @@ public:
 		FileList queryFiles;
 		queryFiles.set_root_dir(in_wkdir);
 		queryFiles.load(in_queryimage);
-		// load the descriptors of the query
-		PropertyReaderT<vec_vec_f32_t> reader(in_wkdir + '/' + in_descriptor);
-		
+		// the descriptors of the query are streamed, see below
+		DescriptorStream stream(in_wkdir + '/' + in_descriptor);
+
+		int in_numthreads = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+		if (_co_numthreads.parse_single<int>(args, in_numthreads) && in_numthreads < 1) {
+			std::cerr << "image_search: numthreads must be at least 1" << std::endl;
+			return false;
+		}
+
 
 		// -----------------------------------------------------------------
 		// processing
@@ -196,131 +360,77 @@ public:
 		std::cout << "----------------------------" << std::endl;
 		std::cout << "image_search: now processing..." << std::endl;
 		std::cout << "image_search: working dir is " << in_wkdir << std::endl;
-		for (int i = 0; i < reader.size(); i++)
+
+		// load vocabulary and search manager once for all queries
+		vec_vec_f32_t vocabulary;
+		shared_ptr<BofSearchManager> bofSearch;
+		if (search_params.get<std::string>("search_type") == "BofSearch")
 		{
-			std::cout << "image_search: progress " << i + 1 << '/' << reader.size() << std::endl;
+			// parameter --vocabulary must be given
+			if (!_co_vocabulary.parse_single<string>(args, in_vocabulary))
+			{
+				std::cerr << "image_search: when using bag-of-features search, you must also provide the --vocabulary commandline option" << std::endl;
+				print();
+				return false;
+			}
+
+			read_property(vocabulary, in_vocabulary);
+			bofSearch.reset(new BofSearchManager(search_params));
+		}
 
+		if (!bofSearch)
+		{
+			// linear search needs the global descriptor of the query, which the
+			// file of local features does not contain
+			std::cerr << "image_search: unsupported search type " << search_params.get<std::string>("search_type")
+			          << ", only BofSearch is supported with precomputed descriptors" << std::endl;
+			return false;
+		}
+
+		// queries whose retrieval list already exists are skipped, such
+		// that an interrupted batch can simply be restarted
+		vector<index_t> queries;
+		vector<string> outRetrievalListDirs(stream.size()), outRetrievalListPaths(stream.size());
+		for (index_t i = 0; i < stream.size(); i++)
+		{
 			std::istringstream sin(queryFiles.get_relative_filename(i));
 			string retrievalClass;
 			string retrievalFile;
 			std::getline(sin, retrievalClass, '/');
 			std::getline(sin, retrievalFile, '.');
-			string outRetrievalListDir = in_outdir + '/' + retrievalClass;
-			string outRetrievalListPath = in_outdir + '/' + retrievalClass + '/' + retrievalFile;
-			if ((_access(outRetrievalListPath.c_str(), 0)) != -1) {
+			outRetrievalListDirs[i] = in_outdir + '/' + retrievalClass;
+			outRetrievalListPaths[i] = in_outdir + '/' + retrievalClass + '/' + retrievalFile;
+			if ((_access(outRetrievalListPaths[i].c_str(), 0)) != -1) {
 				std::cout << "image_search: progress " << i + 1 << " skipped" << std::endl;
 				continue;
 			}
-			
-			/*string each_queryimg = queryFiles.get_filename(i);
-			mat_8uc3_t image = cv::imread(each_queryimg, 1);
-			anymap_t data;
-			data["image"] = image;
-
-			gen->compute(data);*/
-
-			vector<dist_idx_t> results;
-			
-			if (search_params.get<std::string>("search_type") == "BofSearch")
-			{
-
-				// parameter --vocabulary must be given
-				if (!_co_vocabulary.parse_single<string>(args, in_vocabulary))
-				{
-					std::cerr << "image_search: when using bag-of-features search, you must also provide the --vocabulary commandline option" << std::endl;
-					print();
-					return false;
-				}
-
-
-				vec_vec_f32_t vocabulary;
-				read_property(vocabulary, in_vocabulary);
-
-				// quantize
-				quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
-				vec_vec_f32_t quantized_samples;
-
-				const vec_vec_f32_t& samples = boost::any_cast<vec_vec_f32_t>(reader[i]);
-				quantize_samples_parallel(samples, vocabulary, quantized_samples, quantizer);
-
-				vec_f32_t histvw;
-				build_histvw(quantized_samples, vocabulary.size(), histvw, false);
-
-				// initialize search manager and run query
-				BofSearchManager bofSearch(search_params);
-				bofSearch.query(histvw, in_numresults, results);
-			}
-
-			else if (search_params.get<std::string>("search_type") == "LinearSearch")
-			{
-				//// Tensor descriptor is a bit of a special case as we additionally
-				//// need to pass a 'mask' to the distance function, so we replicate
-				//// most of the functionality implemented in LinearSearchManager
-				//if (gen->parameters().get<string>("name") == "tensor")
-				//{
-				//	string filename = search_params.get<string>("descriptor_file");
-				//	vec_vec_f32_t features;
-				//	read_property(features, filename);
-
-				//	const vec_f32_t& descr = get<vec_f32_t>(data, "features");
-				//	const vector<bool>& mask = get<vector<bool> >(data, "mask");
-				//	std::cout << "mask size=" << mask.size() << std::endl;
-				//	dist_frobenius<vec_f32_t> distfn;
-				//	distfn.mask = &mask;
-				//	linear_search(descr, features, results, in_numresults, distfn);
-
-				//}
-				//else
-				//{
-				//	LinearSearchManager search(search_params);
-				//	image_search(data, search, in_numresults, results);
-				//}
-			}
-			else
-			{
-				std::cerr << "unsupported search type" << std::endl;
-			}
-
-
-#ifdef SHOW_RESULT
-			// output results on the console
-			// use piping to store in a text file (for now)
-			std::cout << "----------------------------" << std::endl;
-			std::cout << "-idx--score--filename-------" << std::endl;
-			std::cout << "----------------------------" << std::endl;
-			for (size_t i = 0; i < results.size(); i++) {
-				string filename = imageFiles.get_relative_filename(results[i].second);
-				std::cout.precision(9);
-				std::cout << i << " " << (float)results[i].first << " " << filename << std::endl;
-			}
-#endif // SHOW_RESULT
+			queries.push_back(i);
+		}
 
-			// store as csv
-			// mkdir outdir/class
-			if (_mkdir(in_outdir.c_str()) != -1) {
-				printf("\nCreate Dir: %s\n", in_outdir.c_str());
-			}
-			if (_mkdir(outRetrievalListDir.c_str()) != -1) {
-				printf("\nCreate Dir: %s\n", outRetrievalListDir.c_str());
-			}
+		// the descriptors are read ahead on a background thread while
+		// the pool quantizes and scores the queries read so far
+		std::cout << "image_search: using " << in_numthreads << " threads" << std::endl;
+		stream.start(queries);
+		descriptor_search search(stream, vocabulary, *bofSearch, imageFiles, in_outdir, outRetrievalListDirs, outRetrievalListPaths,
+		                         in_numresults, queries.size());
+		if (!search.run(in_numthreads))
+		{
+			std::cerr << "image_search: stopped after " << search.num_finished() << " of " << queries.size() << " queries" << std::endl;
+			return false;
+		}
 
-			std::ofstream str;
-			str.open(outRetrievalListPath.c_str());
-			if (str.is_open()) {
-				for (size_t i = 0; i < results.size(); i++) {
-					string filename = imageFiles.get_relative_filename(results[i].second);
-					std::istringstream sin1(filename);
-					std::getline(sin1, filename, '.');
-#ifdef SAVE_SCORE
-					double score = results[i].first;
-					str << std::to_string(score) << ' ' << filename << '\n';
-#else
-					str << filename << '\n';
-#endif
-				}
-			}
+		// effect of query term pruning, if enabled in the search parameters
+		if (bofSearch && bofSearch->pruning().num_queries)
+		{
+			std::cout << "image_search: ";
+			bofSearch->pruning().print(std::cout);
 		}
 
+		if (bofSearch && bofSearch->cache())
+		{
+			std::cout << "image_search: ";
+			bofSearch->cache()->stats().print(std::cout);
+		}
 
 
         return true;
@@ -339,6 +449,7 @@ private:
     CmdOption _co_num_results;
 	CmdOption _co_wkdir;
 	CmdOption _co_outdir;
+    CmdOption _co_numthreads;
 };
 
 
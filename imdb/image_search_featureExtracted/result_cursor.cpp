@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "result_cursor.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace imdb {
+
+ResultCursor::ResultCursor()
+    : _position(0)
+{}
+
+void ResultCursor::reset(const vector<float>& accumulators, const vec_u32_t& document_ids)
+{
+    _candidates.clear();
+    _position = 0;
+
+    for (size_t i = 0; i < accumulators.size(); i++)
+    {
+        if (accumulators[i] == 0) continue;
+        uint32_t id = document_ids.empty() ? static_cast<uint32_t>(i) : document_ids[i];
+        _candidates.push_back(std::make_pair(accumulators[i], id));
+    }
+}
+
+bool ResultCursor::next(size_t num_results, vector<dist_idx_t>& results)
+{
+    results.clear();
+
+    size_t remaining = _candidates.size() - std::min(_position, _candidates.size());
+    size_t n = std::min(num_results, remaining);
+    if (n == 0) return false;
+
+    // only the remaining candidates take part in the selection, so the cost of a page
+    // is linear in the number of candidates not yet returned rather than a full query
+    vector<pair<float, uint32_t> >::iterator first = _candidates.begin() + _position;
+    std::partial_sort(first, first + n, _candidates.end(), std::greater<pair<float, uint32_t> >());
+
+    results.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        results.push_back(dist_idx_t(first[i].first, first[i].second));
+    }
+
+    _position += n;
+    return true;
+}
+
+} // end namespace imdb
@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef RESULT_CURSOR_HPP
+#define RESULT_CURSOR_HPP
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Pages through the results of a single query without re-running the query.
+ *
+ * A ResultCursor keeps the scored candidate set of one query, i.e. all documents that
+ * have a non-zero similarity to the query, stored as compact (score, document id) pairs.
+ * Each call to next() then only needs to select the next best entries from the candidates
+ * that have not yet been returned, instead of recomputing all accumulators and a
+ * larger heap for each page.
+ *
+ * Usage:
+ * -# let BofSearchManager::query() (or InvertedIndex::score() and reset()) fill the cursor
+ * -# call next() for each page, e.g. next(50, results), until it returns false
+ *
+ * Note that documents with a score of zero (i.e. documents that do not share a
+ * single term with the query) are not part of the candidate set and thus never
+ * returned by the cursor.
+ */
+class ResultCursor
+{
+public:
+
+    /// Creates an empty cursor, next() returns false until reset() has been called
+    ResultCursor();
+
+    /**
+     * @brief Replaces the candidate set by all documents with a non-zero score.
+     * @param accumulators accumulators[d] holds the score of document d as computed by InvertedIndex::score()
+     * @param document_ids [optional] permutation table of a reordered index (InvertedIndex::document_ids()), if
+     * given the cursor returns document_ids[d] instead of d
+     */
+    void reset(const vector<float>& accumulators, const vec_u32_t& document_ids = vec_u32_t());
+
+    /**
+     * @brief Returns the next page of results.
+     * @param num_results Desired number of results on this page
+     * @param results A vector of dist_idx_t that holds the result indices in descending order of
+     * similarity. Any potentially existing contents of this vector are cleared before the new
+     * results are added.
+     * @return false if all candidates have already been returned, i.e. results is empty
+     */
+    bool next(size_t num_results, vector<dist_idx_t>& results);
+
+    /// Number of candidates that have already been returned by next()
+    size_t position() const { return _position; }
+
+    /// Total number of candidates, i.e. documents with a non-zero score
+    size_t size() const { return _candidates.size(); }
+
+    /// True if all candidates have been returned
+    bool done() const { return _position >= _candidates.size(); }
+
+private:
+
+    // score/document id pairs; entries [0, _position) are already
+    // returned and sorted, entries [_position, end) are unordered
+    vector<pair<float, uint32_t> > _candidates;
+    size_t                         _position;
+};
+
+} // end namespace imdb
+
+#endif // RESULT_CURSOR_HPP
@@ -47,6 +47,7 @@ shog_generator::shog_generator(const ptree& params)
     , _tiles              (parse<uint>  (_parameters, "generator.tiles", 4))
     , _smoothHist         (parse<bool>  (_parameters, "generator.smooth_hist", true))
     , _samplerName        (parse<string>(_parameters, "generator.sampler.name", "random_area"))
+    , _parallel           (parse<bool>  (_parameters, "generator.parallel", false))     // extract the features of a single image using all processors (OpenMP)
     , _sampler            (ImageSampler::create(_samplerName))
 {
 
@@ -60,6 +61,7 @@ shog_generator::shog_generator(const ptree& params)
     std::cout << " generator.tiles=" << _tiles << std::endl;
     std::cout << " generator.smooth_hist=" << _smoothHist << std::endl;
     std::cout << " generator.sampler.name=" << _samplerName << std::endl;
+    std::cout << " generator.parallel=" << _parallel << std::endl;
 }
 
 
@@ -156,6 +158,7 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
     // This helps to better localize the edges which have been a bit blurred
     // in order to be able to compute smooth orientations.
     Mat orient(gx.size(), CV_32FC2);
+    #pragma omp parallel for if (_parallel)
     for (int r = 0; r < gx.rows; r++) {
         for (int c = 0; c < gx.cols; c++) {
             float gxx = gx.at<float>(r,c);
@@ -176,7 +179,8 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
     }
 
     // split the orientation image into _numOrientation response images and
-    // perform cyclic smoothing along the orientation
+    // perform cyclic smoothing along the orientation, rows are independent
+    #pragma omp parallel for if (_parallel)
     for (int r = 0; r < gx.rows; r++) {
         for (int c = 0; c < gx.cols; c++) {
 
@@ -251,7 +255,9 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
 
 
     // spatial smooting
-    for (size_t i = 0; i < _numOrients; i++)
+    const int numOrients = static_cast<int>(_numOrients);
+    #pragma omp parallel for if (_parallel)
+    for (int i = 0; i < numOrients; i++)
     {
         // copy response image centered into a new, larger image that contains an empty border
         // of size tileSize around all sides. This additional  border is essential to be able to
@@ -293,8 +299,14 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
     // as the keypoints and features vector
     emptyFeatures.resize(keypoints.size(), 0);
 
+    // each keypoint writes its own entry, so the features are in the
+    // same order for any number of threads
+    features.resize(keypoints.size());
+
     // collect orientational responses for each keypoint/region
-    for (size_t i = 0; i < keypoints.size(); i++)
+    const int numKeypoints = static_cast<int>(keypoints.size());
+    #pragma omp parallel for schedule(dynamic, 16) if (_parallel)
+    for (int i = 0; i < numKeypoints; i++)
     {
         //const cv::Point2f& keypoint = keypoints[i];
         const vec_f32_t& keypoint = keypoints[i];
@@ -320,7 +332,7 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
             // skip this patch. It contains no strokes.
             // add empty histogram, filled with zeros,
             // will be (optionally) filtered in a later descriptor computation step
-            features.push_back(histogram);
+            features[i] = histogram;
             emptyFeatures[i] = 1;
             continue;
         }
@@ -373,7 +385,7 @@ void shog_generator::extract(const cv::Mat& image, const vec_vec_f32_t& keypoint
 
 
         // add histogram to the set of local features for that image
-        features.push_back(histogram);
+        features[i] = histogram;
     }
 }
 
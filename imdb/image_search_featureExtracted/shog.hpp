@@ -45,6 +45,7 @@ class shog_generator : public Generator
     const uint         _tiles;
     const bool         _smoothHist;
     const string       _samplerName;
+    const bool         _parallel;
 
     shared_ptr<ImageSampler> _sampler;
 };
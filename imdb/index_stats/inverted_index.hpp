@@ -0,0 +1,473 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef BOF_INDEX_H
+#define BOF_INDEX_H
+
+#include "types.hpp"
+#include "io.hpp"
+#include "tf_idf.hpp"
+#include "posting_store.hpp"
+#include "index_file.hpp"
+#include "numa.hpp"
+#include "deadline.hpp"
+
+
+namespace imdb {
+
+
+/**
+ * @ingroup search
+ * @brief Limits the number of query terms whose posting lists are scanned by InvertedIndex::score().
+ *
+ * The query terms are ranked by their tf-idf weight, only the highest weighted terms are kept. This
+ * trades some accuracy for speed, as the many terms with tiny weights often have long posting lists
+ * but contribute little to the final scores. Both limits can be combined, the default keeps all terms.
+ *
+ * A deadline additionally limits the terms by time: the posting lists are then scanned in descending
+ * order of term weight and scanning stops once the deadline has passed (see query_cost::truncated).
+ * The term of the largest weight is always scanned. Due to the changed order of summation, the scores of
+ * a query finishing within its deadline may differ from those without a deadline in the last bits.
+ * Only InvertedIndex::score() and query() check the deadline, batches always scan all of their terms.
+ */
+struct query_pruning
+{
+    query_pruning() : max_terms(0), weight_mass(1.0f) {}
+
+    /// Keep at most this many terms, 0 means no limit
+    size_t max_terms;
+
+    /// Keep the smallest set of terms whose weights sum up to at least this fraction of the total query weight
+    float weight_mass;
+
+    /// Stop scanning posting lists once this has passed, default: never
+    Deadline deadline;
+
+    bool enabled() const { return max_terms > 0 || weight_mass < 1.0f; }
+};
+
+
+/**
+ * @ingroup search
+ * @brief Work done by a single call of InvertedIndex::score(), used to judge the effect of query_pruning.
+ *
+ * The times are only measured by query() and query_batch(). In a batch, score_ms is the time of scoring
+ * the whole batch, as its queries are scored together.
+ */
+struct query_cost
+{
+    query_cost() : num_terms(0), num_scanned_terms(0), num_postings(0), num_scanned_postings(0), score_ms(0), select_ms(0), rerank_ms(0), truncated(false) {}
+
+    size_t   num_terms;              ///< number of distinct terms in the query
+    size_t   num_scanned_terms;      ///< number of terms left after pruning
+    uint64_t num_postings;           ///< total length of the posting lists of all query terms
+    uint64_t num_scanned_postings;   ///< total length of the posting lists actually scanned
+    double   score_ms;               ///< time spent scoring the documents
+    double   select_ms;              ///< time spent selecting the best results from the scores
+    double   rerank_ms;              ///< time spent re-scoring the candidates, see BofSearchManager parameter "rerank_file"
+    bool     truncated;              ///< true if scanning stopped at the deadline of query_pruning before all terms were scanned
+};
+
+
+/**
+ * @ingroup search
+ * @brief Inverted index, operating on document frequency histograms represented as a vector<float>.
+ *
+ * There are two ways to construct an InvertedIndex:
+ * -# Using the default constructor, this is only useful when loading an InvertedIndex from harddisk
+ * -# Passing in the number of words that your document frequency histograms will have, this
+ *    prepares the InvertedIndex such that in the next step you can add all histograms using addHistogram()
+ *
+ * Usage:
+ * -# Building an InvertedIndex
+ *  - Construct using constructor 2)
+ *  - Add as many documents as desired using addHistogram()
+ *  - call finalize() when done adding documents [required]
+ *  - optionally call apply_tfidf(), to replace raw frequency counts by their tf-idf weights
+ *  - optionally call reorder() to renumber the documents, e.g. using bisection_order()
+ *  - optionally call save() to store on haddisk
+ * -# Merging independently built indexes (e.g. built from slices of a filelist)
+ *  - load the first index, call merge() for each further index in filelist order
+ *  - call finalize() when done merging [required]
+ * -# Using an index to perform a query
+ *  - Construct using Constructor 1)
+ *  - load from harddisk, either completely using load() or using load_tiered() which
+ *    keeps only the posting lists of frequently used terms in memory
+ *  - optionally call place() to move the posting lists to a given NUMA node and/or large pages
+ *  - call query()
+ */
+class InvertedIndex
+{
+
+public:
+
+    /**
+     * @brief Document/Frequency pair storing the frequency of a term and its document id
+     *
+     * This is the fundamental datatype used in the InvertedIndex. It stores
+     * an unsigned 32-bit integer (identifying a document/image) and a floating point
+     * (describing the corresponding frequency).
+     * Note that by explicitly using uint32_t, we limit ourselves
+     * to a maximum of about 4 billion documents/images possibly
+     * being added to the InvertedIndex.
+     */
+    typedef pair<uint32_t, float> doc_freq_pair;
+
+    /**
+     * @brief Sections of the file written by save(), see IndexFileWriter for the file format.
+     *
+     * Posting lists are stored as two flat arrays (SectionPostings, SectionWeights) that
+     * contain the lists of all terms one after the other, the list of term t starts at
+     * entry SectionPostingOffsets[t].
+     */
+    enum section_id
+    {
+        SectionCounts              = 1,  // uint32_t: number of terms, number of documents
+        SectionAverages            = 2,  // float: average document length, average unique document length
+        SectionTermFrequencies     = 3,  // float: _Ft
+        SectionDocumentFrequencies = 4,  // uint32_t: _ft
+        SectionDocumentSizes       = 5,  // float: _documentSizes
+        SectionDocumentUniqueSizes = 6,  // uint32_t: _documentUniqueSizes
+        SectionUniqueTerms         = 7,  // uint32_t: _uniqueWords
+        SectionPostingOffsets      = 8,  // uint64_t: num_terms() + 1 offsets into the following two sections
+        SectionPostings            = 9,  // doc_freq_pair: all raw frequency lists
+        SectionWeights             = 10, // float: all tf-idf weight lists
+        SectionDocumentIds         = 11  // uint32_t: document_ids(), only present in a reordered index
+    };
+
+    /**
+     * @brief Only used for reading in a serialized version of an InvertedIndex from harddisk.
+     */
+    InvertedIndex();
+
+    /**
+     * @brief Used when creating a new InvertedIndex from a given set of frequency histograms.
+     *
+     * We assume that the vocabulary contains the terms [0, num_words-1]
+     * @param num_words Total number of words in the vocabulary, i.e. each histogram you add using addHistogram() must have exactly this size.
+     */
+    InvertedIndex(unsigned int num_words);
+
+
+    /**
+     * @brief Add a frequency histogram to the InvertedIndex.
+     *
+     * The order in which you add documents is important: the first document added will
+     * be identified by id 0, the second by id 1 (and so on) in the result of a query().
+     *
+     * @param histogram histogram[i] denotes the frequency of term i in the document/image the histogram has been computed from
+     */
+    void addHistogram(const vec_f32_t& histogram);
+
+
+    /**
+     * @brief Append all documents of another index to this index.
+     *
+     * The posting lists of \p other are concatenated to the lists of this index with all document
+     * ids of \p other shifted by num_documents(), i.e. the first document of \p other becomes document
+     * num_documents() of this index. The collection statistics (_ft, _Ft and document sizes) are combined.
+     * Only the raw frequencies are merged, so you need to call finalize() after the last merge
+     * to recompute the tf-idf weights of the combined index.
+     *
+     * @param other Index to append, must have the same number of terms as this index
+     * @throw std::runtime_error if the number of terms differs or one of the indexes has been loaded using load_tiered()
+     */
+    void merge(const InvertedIndex& other);
+
+
+    /**
+     * @brief Renumbers the documents of the index.
+     *
+     * Document \p order[i] becomes document i, e.g. to give visually similar documents nearby ids which
+     * results in smaller gaps between the document ids of a posting list (better compressible) and more
+     * local access to the accumulators in score(). The original id of each document is kept in a permutation
+     * table, query() maps its results back using this table, so results still refer to the order in which
+     * the documents have been added (i.e. the filelist order). Can be called on a finalized index, the tf-idf
+     * weights are reordered along with the frequencies.
+     *
+     * @param order Permutation of [0, num_documents()-1], where order[i] is the current id of the document that gets id i
+     * @throw std::runtime_error if order is not a permutation or the index has been loaded using load_tiered()
+     */
+    void reorder(const vec_u32_t& order);
+
+
+    /**
+     * @brief Finalizes the index \b after the last document has been added.
+     *
+     * Additionally computes tf_idf weights using the raw frequency counts from the passed in collection_index.
+     * So if you want to apply tf-idf weighting to 'this' index, you need to pass 'this' as the collection_index.
+     * Note that the t-idf weights are stored additionally to the raw frequency counts. The tf-idf weights are normalized
+     * such that the length of each document is 1 under the l2 norm. Once an index is finalized, you can store it to
+     * harddisk or run query().
+     *
+     * @param collection_index The InvertedIndex to use term frequency statistics from when evaluating the tf_function. Note
+     * that the idf_function always automatically uses this InvertedIndex.
+     * @param tf tf_function to be used for weighting
+     * @param idf idf_function to be used for weighting
+     */
+    void finalize(const InvertedIndex& collection_index, const tf_function &tf, const idf_function &idf);
+
+
+    /**
+     * @brief Perform a query on the InvertedIndex using the passed histogram
+     *
+     * The InvertedIndex computes the dot product between the passed in histogram and all documents stored in the InvertedIndex. Since
+     * the query histogram is usually sparse (i.e. histogram[i] = 0 for most of the i's) this operation can be very fast. The InvertedIndex
+     * returns the most similar set of documents in order of descending similarity to the query histogram. Note that we assume that the
+     * tf-idf weighting has been applied to the InvertedIndex before running a query (thus all document lengths being normalized). tf-idf
+     * weighting (and normalization) is applied to the query histogram using the passed in tf-idf functions.
+     *
+     * @param histogram Query histogram, must have the same size as the histograms added to the index
+     * @param tf tf_function used for weighting the query histogram
+     * @param idf idf_function used for weighting the query histogram
+     * @param numResults number of best-matching documents to return
+     * @param result vector of results, containing
+     * @param pruning [optional] restricts the query terms used for scoring, see score()
+     * @param cost [optional] receives the number of scanned terms and postings
+     */
+    void query(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, uint numResults, vector<dist_idx_t>& result,
+               const query_pruning& pruning = query_pruning(), query_cost* cost = 0) const;
+
+
+    /**
+     * @brief Computes the similarity between the passed histogram and all documents in the InvertedIndex
+     *
+     * This is the scoring part of query() without the final selection of the best matching documents, i.e.
+     * after the call accumulators[d] contains the dot product between the tf-idf weighted query histogram
+     * and document d. Use this if you need access to the complete set of scores, e.g. to page through
+     * the results of a single query using a ResultCursor.
+     *
+     * @param histogram Query histogram, must have the same size as the histograms added to the index
+     * @param tf tf_function used for weighting the query histogram
+     * @param idf idf_function used for weighting the query histogram
+     * @param accumulators vector of scores, resized to num_documents(). Note that in a reordered index
+     * accumulators are indexed by the internal document id, use document_ids() to map them to the
+     * original ids
+     * @param pruning [optional] only the posting lists of the highest weighted query terms are scanned, the
+     * scores are then approximations of the exact dot products
+     * @param cost [optional] receives the number of scanned terms and postings
+     */
+    void score(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, vector<float>& accumulators,
+               const query_pruning& pruning = query_pruning(), query_cost* cost = 0) const;
+
+
+    /**
+     * @brief Performs several queries at once, see query().
+     *
+     * The results are identical to running query() for each histogram. Terms shared by several
+     * queries of the batch are processed together though: their posting lists are traversed (and
+     * fetched from disk in a tiered index) only once, each posting is added to all queries containing
+     * the term. Batching pays off for concurrent queries, whose frequent terms largely overlap.
+     *
+     * @param histograms Query histograms
+     * @param tf tf_function used for weighting the query histograms
+     * @param idf idf_function used for weighting the query histograms
+     * @param numResults number of best-matching documents to return per query
+     * @param results results[q] receives the results of histograms[q]
+     * @param pruning [optional] restricts the query terms used for scoring, applied to each query individually
+     * @param costs [optional] costs[q] receives the number of terms and postings of histograms[q]
+     */
+    void query_batch(const vector<vec_f32_t>& histograms, const tf_function &tf, const idf_function &idf, uint numResults,
+                     vector<vector<dist_idx_t> >& results, const query_pruning& pruning = query_pruning(), vector<query_cost>* costs = 0) const;
+
+    /// Scoring part of query_batch(), accumulators[q] receives the scores of histograms[q], see score().
+    /// Note that the batch always accumulates into normal memory, even with large pages enabled by place().
+    void score_batch(const vector<vec_f32_t>& histograms, const tf_function &tf, const idf_function &idf, vector<vector<float> >& accumulators,
+                     const query_pruning& pruning = query_pruning(), vector<query_cost>* costs = 0) const;
+
+
+    /**
+     * @brief Moves all posting lists in memory into two contiguous arrays placed on a NUMA node.
+     *
+     * After placing, score() reads the postings from these arrays, which are allocated on \p numa_node
+     * (or interleaved over all nodes) and optionally backed by large pages, see PageBuffer. With
+     * \p large_pages, score() also accumulates into a per-thread large page buffer on the node of the
+     * calling thread. To serve threads on several nodes, place one copy of the index per node, see
+     * BofSearchManager. Note that doc_frequency_list() and doc_weight_list() return empty lists afterwards,
+     * and that a placed index can no longer be saved, merged or reordered.
+     *
+     * @param numa_node Node the posting lists are placed on, or PageBuffer::interleave
+     * @param large_pages Back the posting and accumulator arrays by large pages if possible
+     */
+    void place(int numa_node, bool large_pages);
+
+    /// True if the posting lists have been moved using place()
+    inline bool placed() const {return static_cast<bool>(_placedPostings);}
+
+
+    inline const vector<vector<doc_freq_pair> >& doc_frequency_list() const {return _docFrequencyList;}
+    inline const vector<vector<float> >&            doc_weight_list()    const {return _docWeightList;}
+    inline const vec_u32_t&                         ft()                 const {return _ft;}
+    inline const vec_f32_t&                         Ft()                 const {return _Ft;}
+    inline const vec_f32_t&                         document_sizes()     const {return _documentSizes;}
+    inline const vec_u32_t&                         document_unique_sizes() const {return _documentUniqueSizes;}
+    inline const std::set<uint32_t>&                unique_terms()       const {return _uniqueWords;}
+    inline uint32_t                                 num_terms()          const {return _numWords;}
+    inline uint32_t                                 num_documents()      const {return _numDocuments;}
+
+    /// Permutation table of a reordered index (see reorder()), document_ids()[i] is the original id
+    /// of the document with internal id i. Empty if the documents have never been reordered.
+    inline const vec_u32_t&                         document_ids()       const {return _documentIds;}
+
+
+    /// Convenience function to load a serialized InvertedIndex. Both the sectioned format written
+    /// by save() and the legacy format written by operator<< are supported, the format is detected
+    /// automatically. The checksums of all sections of a sectioned file are verified.
+    /// @throw std::ios_base::failure in case reading fails
+    /// @throw std::runtime_error in case the file is corrupt
+    void load(const string& filename);
+
+    /**
+     * @brief Load a serialized InvertedIndex, keeping only the posting lists of 'hot' terms in memory.
+     *
+     * Posting lists of all other ('cold') terms stay on disk and are read on demand during query(), all
+     * cold lists of a query are fetched at once and in parallel before scoring starts. Terms are made
+     * resident in the order given by \p hot_terms until \p max_resident_postings postings are in memory,
+     * the remaining budget is filled with the terms having the longest posting lists, as those are the
+     * terms most likely to appear in a query. Note that doc_frequency_list() and doc_weight_list() return
+     * empty lists for cold terms, and that a tiered index cannot be saved.
+     *
+     * @param filename Index file as written by save()
+     * @param max_resident_postings Maximum number of postings kept in memory
+     * @param hot_terms Terms to keep in memory with highest priority, e.g. the most frequent terms of a query log
+     * @throw std::ios_base::failure in case reading fails
+     */
+    void load_tiered(const string& filename, uint64_t max_resident_postings, const vec_u32_t& hot_terms = vec_u32_t());
+
+    /// Store the InvertedIndex in the sectioned, checksummed format (see section_id). To convert
+    /// an index from the legacy format, simply load() and save() it.
+    /// @throw std::ios_base::failure in case writing fails
+    void save(const string& filename) const;
+
+    /// Store of the posting lists kept on disk, null unless loaded with load_tiered()
+    inline const shared_ptr<ColdPostingStore>& cold_postings() const {return _coldPostings;}
+
+    // serialization operators of the legacy file format (no header, no checksums)
+    friend std::ofstream& operator<<(std::ofstream& stream, const InvertedIndex& index);
+    friend std::ifstream& operator>>(std::ifstream& stream, InvertedIndex& index);
+
+
+private:
+
+    void apply_tfidf(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf);
+
+    // decides which posting lists load_tiered() keeps in memory, ft contains the length of each list
+    static void select_resident_terms(const vec_u32_t& ft, uint64_t max_resident_postings, const vec_u32_t& hot_terms, vector<bool>& resident);
+
+    // reads an index from a sectioned file, if cold is non-null only the lists
+    // of terms with resident[t] == true are read, all others are added to cold
+    void read_sections(IndexFileReader& reader, const vector<bool>& resident, const shared_ptr<ColdPostingStore>& cold);
+
+    // load_tiered() for an index file in the legacy format
+    void load_tiered_legacy(const string& filename, uint64_t max_resident_postings, const vec_u32_t& hot_terms);
+
+    // posting list of a single term, either in memory or in a buffer fetched from disk
+    struct posting_range
+    {
+        const doc_freq_pair* postings;
+        const float*         weights;
+        size_t               length;
+    };
+
+    // tf-idf weights of the terms of a query histogram, sorted by term id, after pruning
+    void weight_query(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, const query_pruning& pruning,
+                      vector<pair<uint32_t, float> >& terms, query_cost* cost) const;
+
+    // locates the posting lists of the given terms (sorted by term id), the lists of cold
+    // terms are all fetched at once into cold_postings/cold_weights, which must be kept
+    // alive as long as lists is used
+    void posting_lists(const vector<uint32_t>& terms, vector<posting_range>& lists,
+                       vector<vector<doc_freq_pair> >& cold_postings, vector<vector<float> >& cold_weights) const;
+
+    // the numResults documents with the highest scores, mapped to their original ids
+    void select_top(const vector<float>& accumulators, uint numResults, vector<dist_idx_t>& result) const;
+
+    // completely "clears" the index, we provide the default parameter
+    // num_words = 0 for those cases where the number of words is not
+    // known beforehand (e.g. in the default constructor, required when
+    // streaming the data from hd) in order to be able to use the same
+    // init() function everywhere
+    void init(unsigned int num_words = 0);
+
+    // index: term t
+    // _ft[t] stores the number of documents that contain term t
+    // (for a given doc, t is only counted once), so the
+    // maximum value of ft for any term may be N
+    vec_u32_t _ft;
+
+    // index: term t
+    // _Ft[t] stores the total number of occurances of t in all documents
+    // (i.e. including multiple occurences in a single doc)
+    vec_f32_t _Ft;
+
+    // index: document d
+    // _documentSizes[d] stores the total number of terms per document
+    // (multiple occurences of a term are counted)
+    // Note that this needs to be a float-based measure as our index
+    // supports non-integer histograms
+    vec_f32_t _documentSizes;
+
+    // index: document d
+    // _documentUniqueSizes[d] stores the total number of
+    // unique terms per document
+    vec_u32_t _documentUniqueSizes;
+
+    // the set of unique terms that have been added to the Index.
+    // Each word only occurs once in this set, even if it has
+    // been contained in more than one document
+    std::set<uint32_t> _uniqueWords;
+
+    // total number of (unique) terms in the *vocabulary*, this
+    // can be more than _uniqueWords.size()
+    uint32_t _numWords;
+
+    // total number of documents added to the index
+    uint32_t _numDocuments;
+
+    // average number of terms per document
+    float _avgDocLen;
+
+    // average number of unique terms per documents
+    float _avgUniqueDocLen;
+
+    // f_{d,t} lists, contains the raw frequency counts
+    vector<vector<pair<uint32_t, float> > > _docFrequencyList;
+
+    // contains the tf-idf weighted and normalized version of the frequencies
+    // i.e. _docWeightList[term_id][list_id] = tf-idf(_docFrequencyList[term_id][list_id]
+    vector<vector<float> > _docWeightList;
+
+
+    // index: internal document id d
+    // _documentIds[d] stores the id the document had when it was added to
+    // the index, empty if the index has not been reordered
+    vec_u32_t _documentIds;
+
+
+    // helps us to check that the index has been finalized before it gets saved
+    bool _finalized;
+
+    // posting lists that have not been loaded into memory, only
+    // used by an index that has been loaded using load_tiered()
+    shared_ptr<ColdPostingStore> _coldPostings;
+
+    // contiguous copies of all resident posting lists made by place(), the
+    // list of term t is [_placedOffsets[t], _placedOffsets[t+1]). Shared
+    // between copies of the index as they are never modified
+    shared_ptr<PageBuffer> _placedPostings;
+    shared_ptr<PageBuffer> _placedWeights;
+    vector<uint64_t>       _placedOffsets;
+
+    // score() accumulates into a per-thread large page buffer
+    bool _largePageAccumulators;
+};
+
+
+} // end namespace
+
+#endif // BOF_INDEX_H
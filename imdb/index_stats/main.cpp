@@ -0,0 +1,321 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+//util/
+#include <types.hpp>
+//io/
+#include <cmdline.hpp>
+#include <property_reader.hpp>
+//search/
+#include <inverted_index.hpp>
+#include <index_file.hpp>
+#include <tf_idf.hpp>
+
+
+using namespace imdb;
+
+
+namespace {
+
+const char* section_name(uint32_t id)
+{
+    switch (id)
+    {
+    case InvertedIndex::SectionCounts:              return "counts";
+    case InvertedIndex::SectionAverages:            return "averages";
+    case InvertedIndex::SectionTermFrequencies:     return "term frequencies (Ft)";
+    case InvertedIndex::SectionDocumentFrequencies: return "document frequencies (ft)";
+    case InvertedIndex::SectionDocumentSizes:       return "document sizes";
+    case InvertedIndex::SectionDocumentUniqueSizes: return "document unique sizes";
+    case InvertedIndex::SectionUniqueTerms:         return "unique terms";
+    case InvertedIndex::SectionPostingOffsets:      return "posting offsets";
+    case InvertedIndex::SectionPostings:            return "postings";
+    case InvertedIndex::SectionWeights:             return "weights";
+    case InvertedIndex::SectionDocumentIds:         return "document ids";
+    default:                                        return "unknown";
+    }
+}
+
+// value at the given percentile of an ascending sorted vector
+template <class T>
+T percentile(const vector<T>& sorted, double p)
+{
+    if (sorted.empty()) return T();
+    size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+string megabytes(uint64_t bytes)
+{
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(2) << bytes / (1024.0 * 1024.0) << " MB";
+    return s.str();
+}
+
+} // end anonymous namespace
+
+
+class command_stats : public Command
+{
+public:
+
+    command_stats()
+        : Command("index_stats [options]")
+        , _co_index("index"                  , "i", "filename of the index file to inspect [required]")
+        , _co_queries("queries"              , "q", "filename to vector of query histograms of visual words (as written by compute_histvw), replayed to predict the posting volume per query [optional]")
+        , _co_idf("idf"                      , "f", "idf function used for the idf distribution, default: video_google [optional]")
+        , _co_top("top"                      , "n", "number of terms listed in the top-N tables, default: 20 [optional]")
+        , _co_dominant("dominant"            , "d", "terms causing more than this fraction of the total posting volume are flagged as dominant, default: 0.01 [optional]")
+    {
+        add(_co_index);
+        add(_co_queries);
+        add(_co_idf);
+        add(_co_top);
+        add(_co_dominant);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+
+        warn_for_unknown_option(args);
+
+        string in_index;
+        string in_queries;
+        string in_idf = "video_google";
+        size_t in_top = 20;
+        double in_dominant = 0.01;
+
+        // check that the required options are available
+        if (!_co_index.parse_single<string>(args, in_index))
+        {
+            print();
+            return false;
+        }
+
+        _co_queries.parse_single<string>(args, in_queries);
+        _co_idf.parse_single<string>(args, in_idf);
+        _co_top.parse_single<size_t>(args, in_top);
+        _co_dominant.parse_single<double>(args, in_dominant);
+
+        try {
+            // only the statistics are needed, so no posting list
+            // has to be loaded into memory
+            InvertedIndex index;
+            index.load_tiered(in_index, 0);
+
+            std::cout << "index_stats: " << in_index << std::endl
+                      << "  terms: " << index.num_terms() << " (" << index.unique_terms().size() << " used)" << std::endl
+                      << "  documents: " << index.num_documents() << (index.document_ids().empty() ? "" : " (reordered)") << std::endl
+                      << "  postings: " << index.cold_postings()->num_postings() << std::endl;
+
+            report_memory(in_index, index);
+            report_posting_lengths(index, in_top);
+            report_idf(index, in_idf);
+
+            // without a query log, assume each term is equally likely to be used
+            // in a query, i.e. the cost caused by a term is its posting list length
+            vector<double> volume(index.ft().begin(), index.ft().end());
+            if (!in_queries.empty()) replay_queries(in_queries, index, volume);
+            report_dominant_terms(index, volume, in_top, in_dominant, !in_queries.empty());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "index_stats: error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    void report_memory(const string& filename, const InvertedIndex& index)
+    {
+        std::cout << std::endl << "memory by section:" << std::endl;
+
+        if (index_file::is_sectioned(filename))
+        {
+            IndexFileReader reader(filename);
+            const vector<index_file::section_info>& sections = reader.sections();
+            for (size_t i = 0; i < sections.size(); i++)
+            {
+                std::cout << "  " << std::left << std::setw(28) << section_name(sections[i].id) << std::right
+                          << std::setw(12) << megabytes(sections[i].size) << std::endl;
+            }
+        }
+        else
+        {
+            // legacy file, estimate the size of the loaded datastructures
+            uint64_t numPostings = index.cold_postings()->num_postings();
+            std::cout << "  (legacy file format, in-memory sizes)" << std::endl
+                      << "  " << std::left << std::setw(28) << "postings" << std::right << std::setw(12) << megabytes(numPostings * sizeof(InvertedIndex::doc_freq_pair)) << std::endl
+                      << "  " << std::left << std::setw(28) << "weights" << std::right << std::setw(12) << megabytes(numPostings * sizeof(float)) << std::endl
+                      << "  " << std::left << std::setw(28) << "term statistics" << std::right << std::setw(12) << megabytes(index.num_terms() * (sizeof(uint32_t) + sizeof(float))) << std::endl
+                      << "  " << std::left << std::setw(28) << "document statistics" << std::right << std::setw(12) << megabytes(index.num_documents() * (sizeof(uint32_t) + sizeof(float))) << std::endl;
+        }
+    }
+
+    void report_posting_lengths(const InvertedIndex& index, size_t top)
+    {
+        const vec_u32_t& ft = index.ft();
+        uint64_t numPostings = index.cold_postings()->num_postings();
+
+        // bucket b contains the lists with a length in [2^(b-1), 2^b), bucket 0 the empty lists
+        vector<uint64_t> numLists(33, 0);
+        vector<uint64_t> bucketPostings(33, 0);
+        for (size_t t = 0; t < ft.size(); t++)
+        {
+            uint32_t b = 0;
+            for (uint32_t length = ft[t]; length; length >>= 1) b++;
+            numLists[b]++;
+            bucketPostings[b] += ft[t];
+        }
+
+        std::cout << std::endl << "posting list length histogram:" << std::endl
+                  << "  " << std::setw(24) << "length" << std::setw(12) << "terms" << std::setw(14) << "postings" << std::setw(10) << "share" << std::endl;
+        for (size_t b = 0; b < numLists.size(); b++)
+        {
+            if (!numLists[b]) continue;
+
+            std::ostringstream range;
+            if (b == 0) range << "0";
+            else range << (uint64_t(1) << (b - 1)) << " - " << ((uint64_t(1) << b) - 1);
+
+            std::cout << "  " << std::setw(24) << range.str() << std::setw(12) << numLists[b] << std::setw(14) << bucketPostings[b]
+                      << std::setw(9) << std::fixed << std::setprecision(2) << (numPostings ? 100.0 * bucketPostings[b] / numPostings : 0) << "%" << std::endl;
+        }
+
+        vector<pair<uint32_t, uint32_t> > byLength(ft.size());
+        for (uint32_t t = 0; t < ft.size(); t++) byLength[t] = std::make_pair(ft[t], t);
+        std::sort(byLength.begin(), byLength.end(), std::greater<pair<uint32_t, uint32_t> >());
+
+        std::cout << std::endl << "top " << top << " longest posting lists:" << std::endl
+                  << "  " << std::setw(10) << "term" << std::setw(14) << "length" << std::setw(10) << "share" << std::setw(16) << "% of documents" << std::endl;
+        for (size_t i = 0; i < std::min(top, byLength.size()); i++)
+        {
+            std::cout << "  " << std::setw(10) << byLength[i].second << std::setw(14) << byLength[i].first
+                      << std::setw(9) << std::fixed << std::setprecision(2) << (numPostings ? 100.0 * byLength[i].first / numPostings : 0) << "%"
+                      << std::setw(15) << (index.num_documents() ? 100.0 * byLength[i].first / index.num_documents() : 0) << "%" << std::endl;
+        }
+    }
+
+    void report_idf(const InvertedIndex& index, const string& idf_name)
+    {
+        shared_ptr<idf_function> idf = make_idf(idf_name);
+
+        // unused terms have no defined idf
+        vec_f32_t values;
+        for (uint32_t t = 0; t < index.num_terms(); t++)
+        {
+            if (index.ft()[t]) values.push_back((*idf)(&index, t));
+        }
+        std::sort(values.begin(), values.end());
+        if (values.empty()) return;
+
+        std::cout << std::endl << "idf distribution (" << idf_name << "):" << std::endl << std::setprecision(4)
+                  << "  min " << values.front() << ", p10 " << percentile(values, 0.1) << ", p50 " << percentile(values, 0.5)
+                  << ", p90 " << percentile(values, 0.9) << ", max " << values.back() << std::endl;
+
+        const size_t numBuckets = 10;
+        float width = (values.back() - values.front()) / numBuckets;
+        vector<size_t> counts(numBuckets, 0);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            size_t b = width > 0 ? static_cast<size_t>((values[i] - values.front()) / width) : 0;
+            counts[std::min(b, numBuckets - 1)]++;
+        }
+        for (size_t b = 0; b < numBuckets; b++)
+        {
+            std::cout << "  [" << std::setw(8) << values.front() + b * width << ", " << std::setw(8) << values.front() + (b + 1) * width << ")"
+                      << std::setw(12) << counts[b] << std::endl;
+        }
+    }
+
+    // predicted number of postings traversed by each query, volume[t] receives the
+    // total number of postings of term t traversed over all queries
+    void replay_queries(const string& filename, const InvertedIndex& index, vector<double>& volume)
+    {
+        PropertyReaderT<vec_f32_t> reader(filename);
+        const vec_u32_t& ft = index.ft();
+
+        volume.assign(index.num_terms(), 0);
+        vector<uint64_t> perQuery(reader.size());
+
+        for (index_t i = 0; i < reader.size(); i++)
+        {
+            const vec_f32_t& histogram = reader[i];
+            if (histogram.size() != index.num_terms()) throw std::runtime_error("query histograms do not match the number of terms of the index");
+
+            for (uint32_t t = 0; t < histogram.size(); t++)
+            {
+                if (!histogram[t]) continue;
+                perQuery[i] += ft[t];
+                volume[t] += ft[t];
+            }
+        }
+        std::sort(perQuery.begin(), perQuery.end());
+
+        double mean = 0;
+        for (size_t i = 0; i < perQuery.size(); i++) mean += perQuery[i];
+        if (!perQuery.empty()) mean /= perQuery.size();
+
+        std::cout << std::endl << "posting volume of " << perQuery.size() << " replayed queries:" << std::endl << std::fixed << std::setprecision(0)
+                  << "  mean " << mean << ", p50 " << percentile(perQuery, 0.5) << ", p95 " << percentile(perQuery, 0.95)
+                  << ", p99 " << percentile(perQuery, 0.99) << ", max " << (perQuery.empty() ? 0 : perQuery.back()) << std::endl;
+    }
+
+    void report_dominant_terms(const InvertedIndex& index, const vector<double>& volume, size_t top, double dominant, bool replayed)
+    {
+        double total = 0;
+        for (size_t t = 0; t < volume.size(); t++) total += volume[t];
+        if (total <= 0) return;
+
+        vector<pair<double, uint32_t> > byVolume(volume.size());
+        for (uint32_t t = 0; t < volume.size(); t++) byVolume[t] = std::make_pair(volume[t], t);
+        std::sort(byVolume.begin(), byVolume.end(), std::greater<pair<double, uint32_t> >());
+
+        std::cout << std::endl << "top " << top << " terms by " << (replayed ? "replayed query" : "posting") << " volume:" << std::endl
+                  << "  " << std::setw(10) << "term" << std::setw(14) << "length" << std::setw(10) << "share" << std::endl;
+
+        size_t numDominant = 0;
+        for (size_t i = 0; i < byVolume.size(); i++)
+        {
+            double share = byVolume[i].first / total;
+            bool isDominant = share > dominant;
+            if (isDominant) numDominant++;
+            if (i >= top && !isDominant) break;
+
+            std::cout << "  " << std::setw(10) << byVolume[i].second << std::setw(14) << index.ft()[byVolume[i].second]
+                      << std::setw(9) << std::fixed << std::setprecision(2) << 100.0 * share << "%" << (isDominant ? "  DOMINANT" : "") << std::endl;
+        }
+
+        std::cout << std::endl << "index_stats: " << numDominant << " terms cause more than " << 100.0 * dominant
+                  << "% of the posting volume each" << (numDominant ? ", consider pruning these terms or a larger vocabulary" : "") << std::endl;
+    }
+
+    CmdOption _co_index;
+    CmdOption _co_queries;
+    CmdOption _co_idf;
+    CmdOption _co_top;
+    CmdOption _co_dominant;
+};
+
+
+int main(int argc, char *argv[])
+{
+    command_stats cmd;
+    bool okay = cmd.run(argv_to_strings(argc-1, &argv[1]));
+    return okay ? 0:1;
+}
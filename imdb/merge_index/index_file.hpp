@@ -0,0 +1,168 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef INDEX_FILE_HPP
+#define INDEX_FILE_HPP
+
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/utility.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @addtogroup io
+ * @{
+ */
+
+/**
+ * @brief Layout of a sectioned index file as written by IndexFileWriter.
+ *
+ * A sectioned file consists of
+ * -# a header: magic bytes, format version and the number of sections
+ * -# a table of contents with one entry per section: section id, size of a single element,
+ *    offset and size of the section in bytes and a crc32 checksum over the section data
+ * -# the sections themselves, each one a flat array of elements starting at a 64-byte aligned
+ *    file offset, so that a section can be mapped into memory and used in place.
+ *
+ * Each section can be read (and its checksum verified) independently of all others.
+ */
+namespace index_file
+{
+    /// All section offsets in the file are a multiple of this
+    static const uint64_t alignment = 64;
+
+    /// if you change the internal format, be sure to also adapt reader and writer
+    static const uint32_t version = 1;
+
+    struct header
+    {
+        char     magic[8];      // "IMDBINDX"
+        uint32_t version;
+        uint32_t num_sections;
+    };
+
+    struct section_info
+    {
+        uint32_t id;
+        uint32_t element_size;
+        uint64_t offset;
+        uint64_t size;          // in bytes, without alignment padding
+        uint32_t checksum;      // crc32 over the section data
+        uint32_t reserved;
+    };
+
+    /// True if filename starts with the magic bytes of a sectioned file
+    bool is_sectioned(const string& filename);
+
+    /// crc32 checksum as stored in the table of contents
+    uint32_t checksum(const void* data, uint64_t size);
+}
+
+
+/**
+ * @brief Writes a sectioned file, see index_file for a description of the format.
+ *
+ * Add all sections using add() and store them with write(). Note that the section data
+ * is not copied, it must stay valid until write() has been called.
+ */
+class IndexFileWriter
+{
+public:
+
+    /// Add a section containing the elements of v, id must be unique within the file
+    template <class T>
+    void add(uint32_t id, const vector<T>& v)
+    {
+        add(id, sizeof(T), v.empty() ? 0 : &v[0], v.size() * sizeof(T));
+    }
+
+    /// Add a section containing size bytes at data, made up of elements of element_size bytes
+    void add(uint32_t id, uint32_t element_size, const void* data, uint64_t size);
+
+    /// @throw std::ios_base::failure in case writing fails
+    void write(const string& filename) const;
+
+private:
+
+    struct pending_section
+    {
+        index_file::section_info info;
+        const char*              data;
+    };
+
+    vector<pending_section> _sections;
+};
+
+
+/**
+ * @brief Reads a sectioned file written by IndexFileWriter.
+ *
+ * The constructor only reads the header and the table of contents, sections are
+ * read lazily one at a time using read().
+ *
+ * Note: instances are noncopyable since they internally open files.
+ */
+class IndexFileReader : public boost::noncopyable
+{
+public:
+
+    /// @throw std::runtime_error in case the file cannot be opened, is not a sectioned file or has a different version
+    IndexFileReader(const string& filename);
+
+    bool has_section(uint32_t id) const;
+
+    /// @throw std::runtime_error if the file does not contain a section with this id
+    const index_file::section_info& section(uint32_t id) const;
+
+    /// All sections in the order they are stored in the file
+    const vector<index_file::section_info>& sections() const { return _sections; }
+
+    /**
+     * @brief Read a complete section into v.
+     * @param verify if true, the checksum of the section is compared to the one stored in the file
+     * @throw std::runtime_error if the section is missing, does not consist of elements of type T or is corrupt
+     */
+    template <class T>
+    void read(uint32_t id, vector<T>& v, bool verify = true)
+    {
+        const index_file::section_info& info = section(id);
+        if (info.element_size != sizeof(T))
+        {
+            throw std::runtime_error("section " + boost::lexical_cast<string>(id) + " in file " + _filename + " has an unexpected element size");
+        }
+
+        v.resize(info.size / sizeof(T));
+        read(info, v.empty() ? 0 : &v[0], verify);
+    }
+
+    /// Read size bytes of a section starting at offset (relative to the section start), without verification
+    void read_range(uint32_t id, uint64_t offset, uint64_t size, void* data);
+
+    /// Compares the checksum of a section with the one stored in the file
+    bool verify(uint32_t id);
+
+    const string& filename() const { return _filename; }
+
+private:
+
+    void read(const index_file::section_info& info, void* data, bool verify);
+
+    string                            _filename;
+    std::ifstream                     _ifs;
+    vector<index_file::section_info>  _sections;
+};
+
+/** @} */
+
+} // end namespace imdb
+
+#endif // INDEX_FILE_HPP
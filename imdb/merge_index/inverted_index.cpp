@@ -0,0 +1,1050 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "inverted_index.hpp"
+#include "index_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cassert>
+#include <set>
+#include <map>
+#include <utility>
+#include <queue>
+#include <functional>
+#include <limits>
+#include <cstring>
+
+#include <boost/thread/tss.hpp>
+#include <boost/chrono.hpp>
+
+
+namespace imdb {
+
+namespace {
+
+// accumulators of score() if large page accumulation is enabled, one buffer per
+// thread that is placed on the node the thread was running on when first used
+boost::thread_specific_ptr<PageBuffer> accumulatorBuffer;
+
+bool by_weight_descending(const std::pair<uint32_t, float>& a, const std::pair<uint32_t, float>& b)
+{
+    return a.second > b.second;
+}
+
+} // end anonymous namespace
+
+
+InvertedIndex::InvertedIndex()
+{
+    init();
+}
+
+InvertedIndex::InvertedIndex(unsigned int num_words)
+{
+    init(num_words);
+}
+
+void InvertedIndex::addHistogram(const vec_f32_t &histogram) {
+
+    assert(histogram.size() == _numWords);
+
+    // when the last document has been added, the index needs
+    // to be finalized (call to finalize()). Only then
+    // we are able to compute statistics over *all* documents
+    _finalized = false;
+
+    // must be float to correctly count floating point entries from
+    // the histogram of visual words which is of type vector<float>
+    float numWords = 0;
+    int numUniqueWords = 0;
+
+    for (size_t t = 0; t < histogram.size(); t++)
+    {
+
+        float f_dt = histogram[t];
+
+        if (f_dt)
+        {
+            numWords+=f_dt;
+            numUniqueWords++;
+
+            _ft[t]++;      // count number of docs that term t occurs in
+            _Ft[t]+=f_dt;  // count total number of occurences of t
+
+            // _numDocuments is here "misused" as the index of the currently added document
+            _docFrequencyList[t].push_back(std::make_pair(_numDocuments, f_dt));
+
+            // keep track of all unique words from all histograms added to the index so far
+            _uniqueWords.insert(t);
+        }
+    }
+
+    _documentSizes.push_back(numWords);
+    _documentUniqueSizes.push_back(numUniqueWords);
+
+    // count number of documents added so far
+    _numDocuments++;
+}
+
+void InvertedIndex::merge(const InvertedIndex& other)
+{
+    if (other._numWords != _numWords)
+    {
+        throw std::runtime_error("cannot merge inverted indexes with a different number of terms: "
+                                 + boost::lexical_cast<string>(_numWords) + " vs. " + boost::lexical_cast<string>(other._numWords));
+    }
+
+    // cold posting lists are not in memory and could not be merged
+    if (_coldPostings || other._coldPostings) throw std::runtime_error("cannot merge an InvertedIndex that has been loaded using load_tiered()");
+    if (placed() || other.placed()) throw std::runtime_error("cannot merge an InvertedIndex whose posting lists have been placed using place()");
+
+    // the merged raw frequencies need a new tf-idf weighting
+    _finalized = false;
+
+    const uint32_t offset = _numDocuments;
+
+    for (uint32_t t = 0; t < _numWords; t++)
+    {
+        const vector<doc_freq_pair>& list = other._docFrequencyList[t];
+
+        // the documents of other all have larger ids than those in
+        // this index, so the merged lists stay sorted by document id
+        _docFrequencyList[t].reserve(_docFrequencyList[t].size() + list.size());
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            _docFrequencyList[t].push_back(std::make_pair(list[i].first + offset, list[i].second));
+        }
+
+        _ft[t] += other._ft[t];
+        _Ft[t] += other._Ft[t];
+    }
+
+    _documentSizes.insert(_documentSizes.end(), other._documentSizes.begin(), other._documentSizes.end());
+    _documentUniqueSizes.insert(_documentUniqueSizes.end(), other._documentUniqueSizes.begin(), other._documentUniqueSizes.end());
+    _uniqueWords.insert(other._uniqueWords.begin(), other._uniqueWords.end());
+
+    // keep the permutation tables of reordered indexes, ids of other
+    // are shifted the same way as its document ids
+    if (!_documentIds.empty() || !other._documentIds.empty())
+    {
+        if (_documentIds.empty())
+        {
+            _documentIds.resize(offset);
+            for (uint32_t d = 0; d < offset; d++) _documentIds[d] = d;
+        }
+        for (uint32_t d = 0; d < other._numDocuments; d++)
+        {
+            _documentIds.push_back(offset + (other._documentIds.empty() ? d : other._documentIds[d]));
+        }
+    }
+
+    _numDocuments += other._numDocuments;
+}
+
+void InvertedIndex::reorder(const vec_u32_t& order)
+{
+    if (_coldPostings) throw std::runtime_error("cannot reorder an InvertedIndex that has been loaded using load_tiered()");
+    if (placed()) throw std::runtime_error("cannot reorder an InvertedIndex whose posting lists have been placed using place()");
+
+    // newIds[d] is the new id of the document that currently has id d
+    const uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+    vec_u32_t newIds(_numDocuments, unassigned);
+    if (order.size() != _numDocuments) throw std::runtime_error("document order must contain " + boost::lexical_cast<string>(_numDocuments) + " entries");
+    for (uint32_t i = 0; i < _numDocuments; i++)
+    {
+        if (order[i] >= _numDocuments || newIds[order[i]] != unassigned) throw std::runtime_error("document order is not a permutation");
+        newIds[order[i]] = i;
+    }
+
+    // renumber all postings, the lists need to be sorted by document id again
+    // and the weights (if already computed) must follow their postings
+    vector<pair<doc_freq_pair, float> > list;
+    for (uint32_t t = 0; t < _numWords; t++)
+    {
+        vector<doc_freq_pair>& df_list = _docFrequencyList[t];
+        vector<float>& weight_list = _docWeightList[t];
+        bool weighted = (weight_list.size() == df_list.size());
+
+        list.resize(df_list.size());
+        for (size_t i = 0; i < df_list.size(); i++)
+        {
+            list[i] = std::make_pair(std::make_pair(newIds[df_list[i].first], df_list[i].second), weighted ? weight_list[i] : 0.0f);
+        }
+        std::sort(list.begin(), list.end());
+
+        for (size_t i = 0; i < list.size(); i++)
+        {
+            df_list[i] = list[i].first;
+            if (weighted) weight_list[i] = list[i].second;
+        }
+    }
+
+    vec_f32_t documentSizes(_numDocuments);
+    vec_u32_t documentUniqueSizes(_numDocuments);
+    vec_u32_t documentIds(_numDocuments);
+    for (uint32_t i = 0; i < _numDocuments; i++)
+    {
+        documentSizes[i] = _documentSizes[order[i]];
+        documentUniqueSizes[i] = _documentUniqueSizes[order[i]];
+        documentIds[i] = _documentIds.empty() ? order[i] : _documentIds[order[i]];
+    }
+    _documentSizes.swap(documentSizes);
+    _documentUniqueSizes.swap(documentUniqueSizes);
+    _documentIds.swap(documentIds);
+}
+
+void InvertedIndex::finalize(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf) {
+
+    // compute average document length
+    _avgDocLen = 0.0f;
+    for (size_t i = 0; i < _documentSizes.size(); i++) _avgDocLen += _documentSizes[i];
+    _avgDocLen /= _documentSizes.size();
+
+    // compute average unique document length
+    _avgUniqueDocLen = 0.0f;
+    for (size_t i = 0; i < _documentUniqueSizes.size(); i++) _avgUniqueDocLen += _documentUniqueSizes[i];
+    _avgUniqueDocLen /= _documentUniqueSizes.size();
+
+    // apply weighting
+    apply_tfidf(collection_index, tf, idf);
+
+    _finalized = true;
+}
+
+
+
+void InvertedIndex::apply_tfidf(const InvertedIndex& collection_index, const tf_function& tf, const idf_function& idf) {
+
+    // _docWeightList should already have the correct size
+    // from the init() function
+    assert(_docWeightList.size() == _docFrequencyList.size());
+
+    // compute document lengths under tf-idf weighting function
+    vector<float> documentLengths(_numDocuments, 0);
+    for (uint32_t term_id = 0; term_id < _numWords; term_id++)
+    {
+        size_t numListItems = _docFrequencyList[term_id].size();
+        _docWeightList[term_id].resize(numListItems);
+
+        for (size_t list_id = 0; list_id < numListItems; list_id++)
+        {
+            uint32_t doc_id = _docFrequencyList[term_id][list_id].first;
+
+             // term frequency is always relative to 'this' index
+            float w_tf = tf(this, term_id, doc_id, list_id);
+
+            // inverse document frequency is always computed using
+            // the statistics from the collection_index. The only purpose
+            // to do this is that we can easily re-use InvertedIndex in a
+            // query to compute stats of a single query histogram -- but of course
+            // we need to use the idf information from the larger collection index
+            float w_idf = idf(&collection_index, term_id);
+
+            // tf * idf
+            float weight = w_tf * w_idf;
+
+            // prepare for l2 normalization
+            documentLengths[doc_id] += weight*weight;
+
+            // store tf-idf weights in an extra index
+            _docWeightList[term_id][list_id] = weight;
+        }
+    }
+
+    // l2 normalization
+    for (uint32_t i = 0; i < _numDocuments; i++)
+        documentLengths[i] = std::sqrt(documentLengths[i]);
+
+
+
+    // one final pass over the index to normalize all tf-idf weights
+    // such that the length of each document is 1 according to l2 norm
+    for (uint32_t term_id = 0; term_id < _numWords; term_id++)
+    {
+        size_t numListItems = _docWeightList[term_id].size();
+        for (size_t list_id = 0; list_id < numListItems; list_id++)
+        {
+            uint32_t doc_id = _docFrequencyList[term_id][list_id].first;
+            _docWeightList[term_id][list_id] /= documentLengths[doc_id];
+        }
+    }
+}
+
+
+
+void InvertedIndex::query(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, uint numResults, vector<dist_idx_t>& result,
+                          const query_pruning& pruning, query_cost* cost) const
+{
+    using namespace boost::chrono;
+    steady_clock::time_point start = steady_clock::now();
+
+    // TODO: maybe make this a member so we do not have frequent re-allocations for each query
+    // TODO: test making this a map
+    vector<float> accumulators;
+    score(histogram, tf, idf, accumulators, pruning, cost);
+
+    steady_clock::time_point scored = steady_clock::now();
+
+    select_top(accumulators, numResults, result);
+
+    if (cost)
+    {
+        cost->score_ms = duration<double, boost::milli>(scored - start).count();
+        cost->select_ms = duration<double, boost::milli>(steady_clock::now() - scored).count();
+    }
+}
+
+
+void InvertedIndex::query_batch(const vector<vec_f32_t>& histograms, const tf_function &tf, const idf_function &idf, uint numResults,
+                                vector<vector<dist_idx_t> >& results, const query_pruning& pruning, vector<query_cost>* costs) const
+{
+    using namespace boost::chrono;
+    steady_clock::time_point start = steady_clock::now();
+
+    vector<vector<float> > accumulators;
+    score_batch(histograms, tf, idf, accumulators, pruning, costs);
+
+    const double score_ms = duration<double, boost::milli>(steady_clock::now() - start).count();
+
+    results.resize(histograms.size());
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int q = 0; q < static_cast<int>(histograms.size()); q++)
+    {
+        steady_clock::time_point scored = steady_clock::now();
+        select_top(accumulators[q], numResults, results[q]);
+
+        if (costs)
+        {
+            (*costs)[q].score_ms = score_ms;
+            (*costs)[q].select_ms = duration<double, boost::milli>(steady_clock::now() - scored).count();
+        }
+    }
+}
+
+
+void InvertedIndex::select_top(const vector<float>& accumulators, uint numResults, vector<dist_idx_t>& result) const
+{
+    // limit numResults to the maximum number of possible results
+    numResults = std::min(numResults, _numDocuments);
+
+
+    // Clear the vector and resize it exactly to the required size
+    // so we do not experience multiple automatic vector-internal resizing steps.
+    // Both operations should be extremely cheap if the vector
+    // already has the correct size, i.e. when we re-use a vector from a
+    // prvious query.
+    result.clear();
+    result.reserve(numResults);
+
+
+    // we use a priority_queue with std::greater as the comparator,
+    // this means, that only elements will get added with a push()
+    // that are greater than the currently smallest element in the queue,
+    // i.e. the queue retains the largest entries from the accumulator with
+    // the smallest element in the queue sorted on top of the queue
+    std::priority_queue<dist_idx_t, std::vector<dist_idx_t>, std::greater<dist_idx_t> > queue;
+
+    for (uint i = 0; i < _numDocuments; i++)
+    {
+        queue.push(dist_idx_t(accumulators[i], i));
+        if (queue.size() > numResults) queue.pop();
+    }
+    assert(queue.size() <= numResults);
+
+    // DO NOT CHANGE the limit to queue.size() in the loop,
+    // since queue becomes smaller each iteration!
+    for (uint i = 0; i < numResults; i++)
+    {
+        result.push_back(queue.top());
+        queue.pop();
+
+        // report the original document id in a reordered index
+        if (!_documentIds.empty()) result.back().second = _documentIds[result.back().second];
+    }
+
+    // need to reverse, since the smallest element out of the queue is sorted on top
+    std::reverse(result.begin(), result.end());
+}
+
+
+void InvertedIndex::score(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, vector<float>& accumulators,
+                          const query_pruning& pruning, query_cost* cost) const
+{
+    vector<pair<uint32_t, float> > queryTerms;
+    weight_query(histogram, tf, idf, pruning, queryTerms, cost);
+
+    // with a deadline, the terms contributing most are scanned first
+    if (pruning.deadline.limited())
+    {
+        std::sort(queryTerms.begin(), queryTerms.end(), by_weight_descending);
+    }
+
+    // with large pages, the scores are accumulated in a per-thread buffer
+    // and copied to the result sequentially after the scattered updates
+    float* acc = 0;
+    if (_largePageAccumulators)
+    {
+        const size_t bytes = _numDocuments * sizeof(float);
+        if (!accumulatorBuffer.get() || accumulatorBuffer->size() < bytes) accumulatorBuffer.reset(new PageBuffer(bytes, numa::current_node(), true));
+        acc = static_cast<float*>(accumulatorBuffer->data());
+        std::memset(acc, 0, bytes);
+    }
+    else
+    {
+        accumulators.assign(_numDocuments, 0);
+        if (_numDocuments) acc = &accumulators[0];
+    }
+
+    vector<uint32_t> terms;
+    for (size_t i = 0; i < queryTerms.size(); i++) terms.push_back(queryTerms[i].first);
+
+    vector<posting_range> lists;
+    vector<vector<doc_freq_pair> > coldFrequencyLists;
+    vector<vector<float> > coldWeightLists;
+    posting_lists(terms, lists, coldFrequencyLists, coldWeightLists);
+
+    for (size_t i = 0; i < queryTerms.size(); i++)
+    {
+        // return the scores of the terms scanned so far
+        if (i > 0 && pruning.deadline.expired())
+        {
+            if (cost)
+            {
+                cost->truncated = true;
+                cost->num_scanned_terms = i;
+                cost->num_scanned_postings = 0;
+                for (size_t j = 0; j < i; j++) cost->num_scanned_postings += lists[j].length;
+            }
+            break;
+        }
+
+        // tf-idf weight of the current term in the query
+        float wqt = queryTerms[i].second;
+
+        // iterate over the list of document/frequency pairs for
+        // the current term
+        const posting_range& list = lists[i];
+        for (size_t list_id = 0; list_id < list.length; list_id++)
+        {
+            uint32_t doc_id = list.postings[list_id].first;
+
+            // tf-idf weight of the current term and the document
+            // in this index at list_id
+            float wdt = list.weights[list_id];
+
+            // compute dot product
+            acc[doc_id] +=  wdt*wqt;
+        }
+    }
+
+    if (_largePageAccumulators) accumulators.assign(acc, acc + _numDocuments);
+}
+
+
+void InvertedIndex::score_batch(const vector<vec_f32_t>& histograms, const tf_function &tf, const idf_function &idf, vector<vector<float> >& accumulators,
+                                const query_pruning& pruning, vector<query_cost>* costs) const
+{
+    if (costs) costs->assign(histograms.size(), query_cost());
+
+    // for each term of any of the queries, the queries containing it and their weight of the term
+    std::map<uint32_t, vector<pair<size_t, float> > > termQueries;
+    for (size_t q = 0; q < histograms.size(); q++)
+    {
+        vector<pair<uint32_t, float> > queryTerms;
+        weight_query(histograms[q], tf, idf, pruning, queryTerms, costs ? &(*costs)[q] : 0);
+
+        for (size_t i = 0; i < queryTerms.size(); i++)
+        {
+            termQueries[queryTerms[i].first].push_back(std::make_pair(q, queryTerms[i].second));
+        }
+    }
+
+    accumulators.resize(histograms.size());
+    for (size_t q = 0; q < histograms.size(); q++) accumulators[q].assign(_numDocuments, 0);
+
+    // cold lists of all queries are fetched at once, each list only once
+    vector<uint32_t> terms;
+    std::map<uint32_t, vector<pair<size_t, float> > >::const_iterator it;
+    for (it = termQueries.begin(); it != termQueries.end(); ++it) terms.push_back(it->first);
+
+    vector<posting_range> lists;
+    vector<vector<doc_freq_pair> > coldFrequencyLists;
+    vector<vector<float> > coldWeightLists;
+    posting_lists(terms, lists, coldFrequencyLists, coldWeightLists);
+
+    // each posting list is traversed once and its postings added to all
+    // queries containing the term, frequent terms are shared by most queries
+    size_t i = 0;
+    vector<float*> acc;
+    vector<float> wqt;
+    for (it = termQueries.begin(); it != termQueries.end(); ++it, ++i)
+    {
+        const vector<pair<size_t, float> >& queries = it->second;
+
+        acc.resize(queries.size());
+        wqt.resize(queries.size());
+        for (size_t k = 0; k < queries.size(); k++)
+        {
+            acc[k] = _numDocuments ? &accumulators[queries[k].first][0] : 0;
+            wqt[k] = queries[k].second;
+        }
+
+        const posting_range& list = lists[i];
+        for (size_t list_id = 0; list_id < list.length; list_id++)
+        {
+            uint32_t doc_id = list.postings[list_id].first;
+            float wdt = list.weights[list_id];
+
+            for (size_t k = 0; k < queries.size(); k++) acc[k][doc_id] += wdt*wqt[k];
+        }
+    }
+}
+
+
+void InvertedIndex::weight_query(const vec_f32_t& histogram, const tf_function &tf, const idf_function &idf, const query_pruning& pruning,
+                                 vector<pair<uint32_t, float> >& terms, query_cost* cost) const
+{
+    using namespace std;
+
+    // Build an inverted index from the query document alone and apply
+    // tf-idf weighting function (note that we need to use the collection
+    // statistic from this index as only it contains the required term
+    // frequency stats over all documents).
+    InvertedIndex indexQuery(_numWords);
+    indexQuery.addHistogram(histogram);
+    indexQuery.finalize(*this, tf, idf);
+
+    set<uint32_t> uniqueTerms = indexQuery.unique_terms();
+    set<uint32_t>::const_iterator cit;
+
+    if (cost)
+    {
+        cost->num_terms = uniqueTerms.size();
+        cost->num_postings = 0;
+        for (cit = uniqueTerms.begin(); cit != uniqueTerms.end(); ++cit) cost->num_postings += _ft[*cit];
+    }
+
+    // keep only the highest weighted query terms
+    if (pruning.enabled())
+    {
+        vector<pair<float, uint32_t> > byWeight;
+        float totalWeight = 0;
+        for (cit = uniqueTerms.begin(); cit != uniqueTerms.end(); ++cit)
+        {
+            float wqt = indexQuery.doc_weight_list()[*cit][0];
+            byWeight.push_back(std::make_pair(wqt, *cit));
+            totalWeight += wqt;
+        }
+        std::sort(byWeight.begin(), byWeight.end(), std::greater<pair<float, uint32_t> >());
+
+        size_t numKept = byWeight.size();
+        if (pruning.max_terms > 0) numKept = std::min(numKept, pruning.max_terms);
+        if (pruning.weight_mass < 1.0f)
+        {
+            float mass = 0;
+            for (size_t i = 0; i < numKept; i++)
+            {
+                mass += byWeight[i].first;
+                if (mass >= pruning.weight_mass * totalWeight) { numKept = i + 1; break; }
+            }
+        }
+
+        uniqueTerms.clear();
+        for (size_t i = 0; i < numKept; i++) uniqueTerms.insert(byWeight[i].second);
+    }
+
+    if (cost)
+    {
+        cost->num_scanned_terms = uniqueTerms.size();
+        cost->num_scanned_postings = 0;
+        for (cit = uniqueTerms.begin(); cit != uniqueTerms.end(); ++cit) cost->num_scanned_postings += _ft[*cit];
+    }
+
+    terms.clear();
+    for (cit = uniqueTerms.begin(); cit != uniqueTerms.end(); ++cit)
+    {
+        terms.push_back(std::make_pair(*cit, indexQuery.doc_weight_list()[*cit][0]));
+    }
+}
+
+
+void InvertedIndex::posting_lists(const vector<uint32_t>& terms, vector<posting_range>& lists,
+                                  vector<vector<doc_freq_pair> >& cold_postings, vector<vector<float> >& cold_weights) const
+{
+    // in a tiered index, fetch the lists of all cold query terms from
+    // disk at once before scoring, rather than one read per term
+    vector<uint32_t> coldTerms;
+    if (_coldPostings)
+    {
+        for (size_t i = 0; i < terms.size(); i++)
+        {
+            if (_coldPostings->contains(terms[i])) coldTerms.push_back(terms[i]);
+        }
+        _coldPostings->fetch(coldTerms, cold_postings, cold_weights);
+    }
+
+    // cold terms are fetched in the same order as we iterate over the query terms
+    size_t coldIndex = 0;
+
+    lists.resize(terms.size());
+    for (size_t i = 0; i < terms.size(); i++)
+    {
+        uint32_t term_id = terms[i];
+        posting_range& list = lists[i];
+
+        bool cold = (coldIndex < coldTerms.size() && coldTerms[coldIndex] == term_id);
+        if (cold)
+        {
+            list.length = cold_postings[coldIndex].size();
+            list.postings = list.length ? &cold_postings[coldIndex][0] : 0;
+            list.weights = list.length ? &cold_weights[coldIndex][0] : 0;
+            coldIndex++;
+        }
+        else if (placed())
+        {
+            list.length = static_cast<size_t>(_placedOffsets[term_id + 1] - _placedOffsets[term_id]);
+            list.postings = static_cast<const doc_freq_pair*>(_placedPostings->data()) + _placedOffsets[term_id];
+            list.weights = static_cast<const float*>(_placedWeights->data()) + _placedOffsets[term_id];
+        }
+        else
+        {
+            list.length = _docFrequencyList[term_id].size();
+            list.postings = list.length ? &_docFrequencyList[term_id][0] : 0;
+            list.weights = list.length ? &_docWeightList[term_id][0] : 0;
+        }
+    }
+}
+
+
+void InvertedIndex::place(int numa_node, bool large_pages)
+{
+    assert(_finalized);
+    if (placed()) throw std::runtime_error("the posting lists of this InvertedIndex have already been placed");
+
+    _placedOffsets.assign(_numWords + 1, 0);
+    for (uint32_t t = 0; t < _numWords; t++) _placedOffsets[t+1] = _placedOffsets[t] + _docFrequencyList[t].size();
+    const uint64_t numPostings = _placedOffsets[_numWords];
+
+    _placedPostings.reset(new PageBuffer(numPostings * sizeof(doc_freq_pair), numa_node, large_pages));
+    _placedWeights.reset(new PageBuffer(numPostings * sizeof(float), numa_node, large_pages));
+
+    doc_freq_pair* postings = static_cast<doc_freq_pair*>(_placedPostings->data());
+    float* weights = static_cast<float*>(_placedWeights->data());
+    for (uint32_t t = 0; t < _numWords; t++)
+    {
+        std::copy(_docFrequencyList[t].begin(), _docFrequencyList[t].end(), postings + _placedOffsets[t]);
+        std::copy(_docWeightList[t].begin(), _docWeightList[t].end(), weights + _placedOffsets[t]);
+
+        // free the memory of the lists rather than only clearing them
+        vector<doc_freq_pair>().swap(_docFrequencyList[t]);
+        vector<float>().swap(_docWeightList[t]);
+    }
+
+    _largePageAccumulators = large_pages;
+
+    std::cout << "InvertedIndex: placed " << numPostings << " postings on "
+              << (numa_node == PageBuffer::interleave ? string("all nodes (interleaved)") : "node " + boost::lexical_cast<string>(numa_node))
+              << (_placedPostings->large_pages() ? " using large pages" : "") << std::endl;
+}
+
+
+void InvertedIndex::init(unsigned int num_words)
+{
+    _finalized = false;
+
+    _ft.clear();
+    _docFrequencyList.clear();
+    _docWeightList.clear();
+    _documentSizes.clear();
+    _documentUniqueSizes.clear();
+    _Ft.clear();
+    _uniqueWords.clear();
+    _documentIds.clear();
+
+    _coldPostings.reset();
+
+    _placedPostings.reset();
+    _placedWeights.reset();
+    _placedOffsets.clear();
+    _largePageAccumulators = false;
+
+    _numWords = num_words;
+    _numDocuments = 0;
+    _avgDocLen = 0;
+    _avgUniqueDocLen = 0;
+
+    _ft.resize(_numWords, 0);
+    _docFrequencyList.resize(_numWords);
+    _docWeightList.resize(_numWords);
+    _Ft.resize(_numWords, 0);
+}
+
+
+void InvertedIndex::load(const std::string& filename)
+{
+    if (index_file::is_sectioned(filename))
+    {
+        IndexFileReader reader(filename);
+        read_sections(reader, vector<bool>(), shared_ptr<ColdPostingStore>());
+        return;
+    }
+
+    // index written in the legacy format, i.e. by operator<<
+    std::ifstream ifs;
+
+    // make ifstream thrown exception when the failbit gets set
+    ifs.exceptions(std::ios::failbit);
+
+    try { ifs.open(filename.c_str(), std::ios::in | std::ios::binary); }
+
+    // catch and rethrow with the sole purpose of providing a better error message
+    // than the library implementation does, which gives "basic_ios::clear"
+    catch (std::ios_base::failure& e)
+    {
+        throw std::ios_base::failure("could not open file " + filename + " for reading inverted index");
+    }
+
+    ifs >> *this;
+    ifs.close();
+}
+
+
+void InvertedIndex::load_tiered(const string& filename, uint64_t max_resident_postings, const vec_u32_t& hot_terms)
+{
+    if (index_file::is_sectioned(filename))
+    {
+        IndexFileReader reader(filename);
+
+        // _ft[t] is exactly the length of the posting list of term t, so we can
+        // decide which lists to keep in memory before reading any of them
+        vec_u32_t ft;
+        reader.read(SectionDocumentFrequencies, ft);
+
+        vector<bool> resident;
+        select_resident_terms(ft, max_resident_postings, hot_terms, resident);
+
+        read_sections(reader, resident, shared_ptr<ColdPostingStore>(new ColdPostingStore(filename, static_cast<uint32_t>(ft.size()))));
+    }
+    else
+    {
+        load_tiered_legacy(filename, max_resident_postings, hot_terms);
+    }
+
+    uint64_t numResident = 0;
+    for (uint32_t t = 0; t < _numWords; t++) numResident += _docFrequencyList[t].size();
+
+    std::cout << "InvertedIndex: " << numResident << " postings resident, "
+              << _coldPostings->num_postings() << " postings of " << _coldPostings->num_terms() << " terms on disk" << std::endl;
+}
+
+
+void InvertedIndex::select_resident_terms(const vec_u32_t& ft, uint64_t max_resident_postings, const vec_u32_t& hot_terms, vector<bool>& resident)
+{
+    const uint32_t numWords = static_cast<uint32_t>(ft.size());
+    resident.assign(numWords, false);
+    uint64_t numResident = 0;
+
+    vector<pair<uint32_t, uint32_t> > byLength(numWords);
+    for (uint32_t t = 0; t < numWords; t++) byLength[t] = std::make_pair(ft[t], t);
+    std::sort(byLength.begin(), byLength.end(), std::greater<pair<uint32_t, uint32_t> >());
+
+    vec_u32_t candidates(hot_terms);
+    for (uint32_t i = 0; i < numWords; i++) candidates.push_back(byLength[i].second);
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        uint32_t t = candidates[i];
+        if (t >= numWords || resident[t] || numResident + ft[t] > max_resident_postings) continue;
+        resident[t] = true;
+        numResident += ft[t];
+    }
+}
+
+
+void InvertedIndex::read_sections(IndexFileReader& reader, const vector<bool>& resident, const shared_ptr<ColdPostingStore>& cold)
+{
+    init();
+    _coldPostings = cold;
+
+    vec_u32_t counts;
+    vec_f32_t averages;
+    reader.read(SectionCounts, counts);
+    reader.read(SectionAverages, averages);
+    if (counts.size() != 2 || averages.size() != 2) throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+
+    _numWords = counts[0];
+    _numDocuments = counts[1];
+    _avgDocLen = averages[0];
+    _avgUniqueDocLen = averages[1];
+
+    reader.read(SectionTermFrequencies, _Ft);
+    reader.read(SectionDocumentFrequencies, _ft);
+    reader.read(SectionDocumentSizes, _documentSizes);
+    reader.read(SectionDocumentUniqueSizes, _documentUniqueSizes);
+
+    vec_u32_t uniqueWords;
+    reader.read(SectionUniqueTerms, uniqueWords);
+    _uniqueWords.insert(uniqueWords.begin(), uniqueWords.end());
+
+    if (reader.has_section(SectionDocumentIds)) reader.read(SectionDocumentIds, _documentIds);
+    if (!_documentIds.empty() && _documentIds.size() != _numDocuments) throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+
+    // posting_offsets[t] is the position of the first entry of term t
+    // in the flat postings/weights sections, posting_offsets[_numWords]
+    // is the total number of postings
+    vector<uint64_t> postingOffsets;
+    reader.read(SectionPostingOffsets, postingOffsets);
+    if (postingOffsets.size() != _numWords + 1 || postingOffsets[0] != 0) throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+    for (uint32_t t = 0; t < _numWords; t++)
+    {
+        if (postingOffsets[t] > postingOffsets[t+1]) throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+    }
+
+    // the offsets are used to index into the posting sections, both must hold exactly the total number of postings
+    if (reader.section(SectionPostings).size != postingOffsets.back() * sizeof(doc_freq_pair)
+        || reader.section(SectionWeights).size != postingOffsets.back() * sizeof(float))
+    {
+        throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+    }
+
+    _docFrequencyList.resize(_numWords);
+    _docWeightList.resize(_numWords);
+
+    if (!_coldPostings)
+    {
+        vector<doc_freq_pair> postings;
+        vec_f32_t weights;
+        reader.read(SectionPostings, postings);
+        reader.read(SectionWeights, weights);
+        if (postings.size() != postingOffsets.back() || weights.size() != postingOffsets.back()) throw std::runtime_error("file " + reader.filename() + " contains an invalid inverted index");
+
+        for (uint32_t t = 0; t < _numWords; t++)
+        {
+            _docFrequencyList[t].assign(postings.begin() + postingOffsets[t], postings.begin() + postingOffsets[t+1]);
+            _docWeightList[t].assign(weights.begin() + postingOffsets[t], weights.begin() + postingOffsets[t+1]);
+        }
+    }
+    else
+    {
+        // Note: the checksums of the posting sections are not verified in this
+        // case as that would require reading the cold lists, too
+        const index_file::section_info& postingSection = reader.section(SectionPostings);
+        const index_file::section_info& weightSection = reader.section(SectionWeights);
+
+        for (uint32_t t = 0; t < _numWords; t++)
+        {
+            uint64_t length = postingOffsets[t+1] - postingOffsets[t];
+
+            if (resident[t])
+            {
+                _docFrequencyList[t].resize(length);
+                _docWeightList[t].resize(length);
+                if (!length) continue;
+                reader.read_range(SectionPostings, postingOffsets[t] * sizeof(doc_freq_pair), length * sizeof(doc_freq_pair), &_docFrequencyList[t][0]);
+                reader.read_range(SectionWeights, postingOffsets[t] * sizeof(float), length * sizeof(float), &_docWeightList[t][0]);
+            }
+            else
+            {
+                ColdPostingStore::location loc;
+                loc.frequency_offset = postingSection.offset + postingOffsets[t] * sizeof(doc_freq_pair);
+                loc.weight_offset = weightSection.offset + postingOffsets[t] * sizeof(float);
+                loc.length = static_cast<uint32_t>(length);
+                _coldPostings->add(t, loc);
+            }
+        }
+    }
+
+    _finalized = true;
+}
+
+
+void InvertedIndex::load_tiered_legacy(const string& filename, uint64_t max_resident_postings, const vec_u32_t& hot_terms)
+{
+    std::ifstream ifs;
+
+    // make ifstream thrown exception when the failbit gets set
+    ifs.exceptions(std::ios::failbit);
+
+    try { ifs.open(filename.c_str(), std::ios::in | std::ios::binary); }
+
+    // catch and rethrow with the sole purpose of providing a better error message
+    // than the library implementation does, which gives "basic_ios::clear"
+    catch (std::ios_base::failure& e)
+    {
+        throw std::ios_base::failure("could not open file " + filename + " for reading inverted index");
+    }
+
+    // same layout as read by operator>>, up to the posting lists
+    init();
+    io::read(ifs, _numWords);
+    io::read(ifs, _numDocuments);
+    io::read(ifs, _avgDocLen);
+    io::read(ifs, _avgUniqueDocLen);
+    io::read(ifs, _Ft);
+    io::read(ifs, _uniqueWords);
+    io::read(ifs, _ft);
+    if (_ft.size() != _numWords) throw std::runtime_error("file " + filename + " contains an invalid inverted index");
+
+    vector<bool> resident;
+    select_resident_terms(_ft, max_resident_postings, hot_terms, resident);
+
+    _coldPostings.reset(new ColdPostingStore(filename, _numWords));
+    vector<ColdPostingStore::location> locations(_numWords);
+
+    // io::write stores a vector<vector<T> > as its size followed by the size and
+    // the raw entries of each inner vector, this lets us skip the cold lists
+    int64_t numLists = 0;
+    io::read(ifs, numLists);
+    if (numLists != static_cast<int64_t>(_numWords)) throw std::runtime_error("file " + filename + " contains an invalid inverted index");
+    _docFrequencyList.resize(numLists);
+    for (int64_t t = 0; t < numLists; t++)
+    {
+        int64_t length = 0;
+        io::read(ifs, length);
+        locations[t].frequency_offset = ifs.tellg();
+        locations[t].length = static_cast<uint32_t>(length);
+
+        if (resident[t])
+        {
+            _docFrequencyList[t].resize(length);
+            if (length) ifs.read(reinterpret_cast<char*>(&_docFrequencyList[t][0]), length * sizeof(doc_freq_pair));
+        }
+        else ifs.seekg(length * sizeof(doc_freq_pair), std::ios::cur);
+    }
+
+    io::read(ifs, numLists);
+    if (numLists != static_cast<int64_t>(_numWords)) throw std::runtime_error("file " + filename + " contains an invalid inverted index");
+    _docWeightList.resize(numLists);
+    for (int64_t t = 0; t < numLists; t++)
+    {
+        int64_t length = 0;
+        io::read(ifs, length);
+        locations[t].weight_offset = ifs.tellg();
+
+        if (resident[t])
+        {
+            _docWeightList[t].resize(length);
+            if (length) ifs.read(reinterpret_cast<char*>(&_docWeightList[t][0]), length * sizeof(float));
+        }
+        else
+        {
+            ifs.seekg(length * sizeof(float), std::ios::cur);
+            _coldPostings->add(t, locations[t]);
+        }
+    }
+
+    io::read(ifs, _documentSizes);
+    io::read(ifs, _documentUniqueSizes);
+    ifs.close();
+
+    _finalized = true;
+}
+
+
+void InvertedIndex::save(const string &filename) const
+{
+    assert(_finalized);
+
+    // the cold posting lists are not in memory and would be written as empty lists
+    if (_coldPostings) throw std::runtime_error("cannot save an InvertedIndex that has been loaded using load_tiered()");
+    if (placed()) throw std::runtime_error("cannot save an InvertedIndex whose posting lists have been placed using place()");
+
+    vec_u32_t counts(2);
+    counts[0] = _numWords;
+    counts[1] = _numDocuments;
+
+    vec_f32_t averages(2);
+    averages[0] = _avgDocLen;
+    averages[1] = _avgUniqueDocLen;
+
+    vec_u32_t uniqueWords(_uniqueWords.begin(), _uniqueWords.end());
+
+    // store all posting lists as one flat array each, indexed by postingOffsets
+    vector<uint64_t> postingOffsets(_numWords + 1, 0);
+    for (uint32_t t = 0; t < _numWords; t++) postingOffsets[t+1] = postingOffsets[t] + _docFrequencyList[t].size();
+
+    vector<doc_freq_pair> postings;
+    vec_f32_t weights;
+    postings.reserve(postingOffsets[_numWords]);
+    weights.reserve(postingOffsets[_numWords]);
+    for (uint32_t t = 0; t < _numWords; t++)
+    {
+        postings.insert(postings.end(), _docFrequencyList[t].begin(), _docFrequencyList[t].end());
+        weights.insert(weights.end(), _docWeightList[t].begin(), _docWeightList[t].end());
+    }
+
+    IndexFileWriter writer;
+    writer.add(SectionCounts, counts);
+    writer.add(SectionAverages, averages);
+    writer.add(SectionTermFrequencies, _Ft);
+    writer.add(SectionDocumentFrequencies, _ft);
+    writer.add(SectionDocumentSizes, _documentSizes);
+    writer.add(SectionDocumentUniqueSizes, _documentUniqueSizes);
+    writer.add(SectionUniqueTerms, uniqueWords);
+    writer.add(SectionPostingOffsets, postingOffsets);
+    writer.add(SectionPostings, postings);
+    writer.add(SectionWeights, weights);
+    if (!_documentIds.empty()) writer.add(SectionDocumentIds, _documentIds);
+
+    try { writer.write(filename); }
+
+    catch (std::ios_base::failure& e)
+    {
+        throw std::ios_base::failure("could not open file " + filename + " for saving inverted index");
+    }
+}
+
+
+std::ofstream& operator<<(std::ofstream& stream, const InvertedIndex& index) {
+
+    assert(index._finalized);
+
+    // the cold posting lists are not in memory and would be written as empty lists
+    if (index._coldPostings) throw std::runtime_error("cannot save an InvertedIndex that has been loaded using load_tiered()");
+    if (index.placed()) throw std::runtime_error("cannot save an InvertedIndex whose posting lists have been placed using place()");
+
+    // the legacy format has no place for the permutation table
+    if (!index._documentIds.empty()) throw std::runtime_error("cannot write a reordered InvertedIndex in the legacy format");
+
+    io::write(stream, index._numWords);
+    io::write(stream, index._numDocuments);
+    io::write(stream, index._avgDocLen);
+    io::write(stream, index._avgUniqueDocLen);
+    io::write(stream, index._Ft);
+    io::write(stream, index._uniqueWords);
+    io::write(stream, index._ft);
+    io::write(stream, index._docFrequencyList);
+    io::write(stream, index._docWeightList);
+    io::write(stream, index._documentSizes);
+    io::write(stream, index._documentUniqueSizes);
+    return stream;
+}
+
+
+std::ifstream& operator>>(std::ifstream& stream, InvertedIndex& index) {
+    index.init();
+    io::read(stream, index._numWords);
+    io::read(stream, index._numDocuments);
+    io::read(stream, index._avgDocLen);
+    io::read(stream, index._avgUniqueDocLen);
+    io::read(stream, index._Ft);
+    io::read(stream, index._uniqueWords);
+    io::read(stream, index._ft);
+    io::read(stream, index._docFrequencyList);
+    io::read(stream, index._docWeightList);
+    io::read(stream, index._documentSizes);
+    io::read(stream, index._documentUniqueSizes);
+    index._finalized = true;
+    return stream;
+}
+
+
+
+} // end namespace imdb
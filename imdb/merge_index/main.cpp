@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <iostream>
+
+#include <QTime>
+
+//util/
+#include <types.hpp>
+//io/
+#include <cmdline.hpp>
+//search/
+#include <inverted_index.hpp>
+#include <tf_idf.hpp>
+
+
+using namespace imdb;
+
+class command_merge : public Command
+{
+public:
+
+    command_merge()
+        : Command("merge_index [options]")
+        , _co_input("input"                  , "i", "filenames of the index files to be merged, in the order of their filelists [required]")
+        , _co_output("output"                , "o", "filename of the merged output index file [required]")
+        , _co_tfidf("tfidf"                  , "t", "two strings specifying tf and idf function to be used (eg. -t constant constant) [required]")
+    {
+        add(_co_input);
+        add(_co_output);
+        add(_co_tfidf);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+
+        warn_for_unknown_option(args);
+
+        vector<string> in_input;
+        string in_output;
+        vector<string> in_tfidf;
+
+        // check that the required options are available
+        if (!_co_input.parse_multiple<string>(args, in_input) ||
+            !_co_output.parse_single<string>(args, in_output) ||
+            !_co_tfidf.parse_multiple<string>(args, in_tfidf) ||
+            in_tfidf.size() != 2)
+        {
+            print();
+            return false;
+        }
+
+
+        std::cout << "merge_index: tf=" << in_tfidf[0] << ", idf=" << in_tfidf[1] << std::endl;
+
+        shared_ptr<tf_function>  tf = make_tf(in_tfidf[0]);
+        shared_ptr<idf_function> idf = make_idf(in_tfidf[1]);
+
+        QTime total;
+        total.start();
+
+
+        try {
+            // the document ids of each shard are appended to those of
+            // the previous shards, so the order of the input files must
+            // match the order of the filelist slices they were built from
+            InvertedIndex index;
+            index.load(in_input[0]);
+            std::cout << "merge_index: " << in_input[0] << " contains " << index.num_documents() << " documents" << std::endl;
+
+            for (size_t i = 1; i < in_input.size(); i++)
+            {
+                InvertedIndex shard;
+                shard.load(in_input[i]);
+                std::cout << "merge_index: " << in_input[i] << " contains " << shard.num_documents() << " documents, first id in merged index: " << index.num_documents() << std::endl;
+                index.merge(shard);
+            }
+
+            std::cout << "merge_index: finalizing " << index.num_documents() << " documents" << std::endl;
+            index.finalize(index, *tf, *idf);
+            std::cout << "merge_index: saving" << std::endl;
+            index.save(in_output);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "merge_index: error: " << e.what() << std::endl;
+            return false;
+        }
+
+
+        std::cout << "merge_index: done." << std::endl;
+        int totalMSElapsed = total.elapsed();
+        std::cout << "merge_index: total time: " << (totalMSElapsed / 1000) << "s" << std::endl;
+
+        return true;
+    }
+
+private:
+
+    CmdOption _co_input;
+    CmdOption _co_output;
+    CmdOption _co_tfidf;
+};
+
+
+int main(int argc, char *argv[])
+{
+    command_merge cmd;
+    bool okay = cmd.run(argv_to_strings(argc-1, &argv[1]));
+    return okay ? 0:1;
+}
@@ -0,0 +1,306 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "bof_search_manager.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <boost/chrono.hpp>
+#include "types.hpp"
+
+namespace imdb {
+
+BofSearchManager::BofSearchManager(const ptree& parameters)
+{
+    string index_file = parameters.get<string>("index_file");
+
+    // get the tf/idf weighting functions from the config,
+    // use the most basic one (constant) as default if none supplied
+
+    // TODO: better throw an exception when the user passes in an
+    // unsupported/misspelled function name
+    string tf = parameters.get<string>("tf", "constant");
+    string idf = parameters.get<string>("idf", "constant");
+
+    std::cout << "BofSearchManager: tf=" << tf << ", idf=" << idf << std::endl;
+
+    _tf  = make_tf(tf);
+    _idf = make_idf(idf);
+
+    boost::optional<uint64_t> max_resident_postings = parameters.get_optional<uint64_t>("max_resident_postings");
+    if (max_resident_postings)
+    {
+        vec_u32_t hot_terms;
+        boost::optional<string> hot_terms_file = parameters.get_optional<string>("hot_terms_file");
+        if (hot_terms_file)
+        {
+            std::ifstream ifs(hot_terms_file->c_str());
+            if (!ifs.is_open()) throw std::runtime_error("could not open hot terms file " + *hot_terms_file);
+
+            uint32_t term_id;
+            while (ifs >> term_id) hot_terms.push_back(term_id);
+        }
+
+        std::cout << "BofSearchManager: tiered index, max_resident_postings=" << *max_resident_postings << std::endl;
+        _index.load_tiered(index_file, *max_resident_postings, hot_terms);
+    }
+    else
+    {
+        _index.load(index_file);
+    }
+
+    string numa_mode = parameters.get<string>("numa", "");
+    bool large_pages = parameters.get<bool>("large_pages", false);
+    if (numa_mode == "replicate")
+    {
+        // copies must be made before _index gets placed, as placing
+        // empties its in-memory posting lists
+        int num_nodes = numa::num_nodes();
+        std::cout << "BofSearchManager: replicating index on " << num_nodes << " NUMA nodes" << std::endl;
+        _replicas.resize(num_nodes);
+        for (int node = 1; node < num_nodes; node++)
+        {
+            _replicas[node].reset(new InvertedIndex(_index));
+            _replicas[node]->place(node, large_pages);
+        }
+        _index.place(0, large_pages);
+    }
+    else if (numa_mode == "interleave")
+    {
+        _index.place(PageBuffer::interleave, large_pages);
+    }
+    else if (!numa_mode.empty())
+    {
+        throw std::runtime_error("unknown numa mode " + numa_mode + ", use replicate or interleave");
+    }
+    else if (large_pages)
+    {
+        _index.place(numa::current_node(), true);
+    }
+
+    _pruning.max_terms = parameters.get<size_t>("prune_max_terms", 0);
+    _pruning.weight_mass = parameters.get<float>("prune_weight_mass", 1.0f);
+    _pruneRecallAt = parameters.get<size_t>("prune_recall_at", 0);
+    if (_pruning.enabled())
+    {
+        std::cout << "BofSearchManager: query term pruning, prune_max_terms=" << _pruning.max_terms
+                  << ", prune_weight_mass=" << _pruning.weight_mass << std::endl;
+    }
+
+    boost::optional<double> cache_size_mb = parameters.get_optional<double>("cache_size_mb");
+    if (cache_size_mb)
+    {
+        std::cout << "BofSearchManager: result cache, cache_size_mb=" << *cache_size_mb << std::endl;
+        _cache.reset(new ResultCache(static_cast<size_t>(*cache_size_mb * 1024 * 1024)));
+    }
+
+    _rerankCandidates = parameters.get<size_t>("rerank_candidates", 1000);
+    boost::optional<string> rerank_file = parameters.get_optional<string>("rerank_file");
+    if (rerank_file)
+    {
+        string rerank_distfn = parameters.get<string>("rerank_distfn", "l2norm");
+        std::cout << "BofSearchManager: re-ranking " << _rerankCandidates << " candidates, rerank_file=" << *rerank_file
+                  << ", rerank_distfn=" << rerank_distfn << std::endl;
+        _reranker.reset(new Reranker(*rerank_file, rerank_distfn));
+        if (_reranker->size() != _index.num_documents())
+        {
+            throw std::runtime_error("rerank file " + *rerank_file + " does not contain a descriptor per indexed document");
+        }
+        if (_reranker->size() > 0 && _reranker->dims() != _index.num_terms())
+        {
+            throw std::runtime_error("rerank file " + *rerank_file + " does not contain histograms over the vocabulary of the index");
+        }
+    }
+}
+
+
+bool BofSearchManager::query(const vec_f32_t& histvw, size_t num_results, vector<dist_idx_t>& results, query_cost* cost,
+                             const Deadline& deadline) const
+{
+    query_cost localCost;
+    if (!cost) cost = &localCost;
+    *cost = query_cost();
+
+    if (_cache && _cache->lookup(histvw, num_results, results)) return true;
+
+    const InvertedIndex& index = local_index();
+
+    query_pruning pruning = _pruning;
+    pruning.deadline = deadline;
+
+    const size_t candidates = num_candidates(num_results);
+    index.query(histvw, *_tf, *_idf, candidates, results, pruning, cost);
+
+    record_pruning(index, histvw, candidates, results, *cost);
+    rerank(histvw, results, num_results, *cost);
+
+    // results of a partial scan must not be served to later queries
+    if (_cache && !cost->truncated) _cache->insert(histvw, num_results, results);
+    return !cost->truncated;
+}
+
+
+void BofSearchManager::query_batch(const vector<vec_f32_t>& histvws, size_t num_results, vector<vector<dist_idx_t> >& results,
+                                   vector<query_cost>* costs) const
+{
+    results.resize(histvws.size());
+    if (costs) costs->assign(histvws.size(), query_cost());
+
+    // only queries missing from the cache are scored
+    vector<vec_f32_t> missed;
+    vector<size_t> missedQueries;
+    for (size_t q = 0; q < histvws.size(); q++)
+    {
+        if (_cache && _cache->lookup(histvws[q], num_results, results[q])) continue;
+
+        missed.push_back(histvws[q]);
+        missedQueries.push_back(q);
+    }
+    if (missed.empty()) return;
+
+    const InvertedIndex& index = local_index();
+
+    vector<vector<dist_idx_t> > missedResults;
+    vector<query_cost> missedCosts;
+    const size_t candidates = num_candidates(num_results);
+    index.query_batch(missed, *_tf, *_idf, candidates, missedResults, _pruning, &missedCosts);
+
+    for (size_t k = 0; k < missed.size(); k++)
+    {
+        record_pruning(index, missed[k], candidates, missedResults[k], missedCosts[k]);
+        rerank(missed[k], missedResults[k], num_results, missedCosts[k]);
+        if (costs) (*costs)[missedQueries[k]] = missedCosts[k];
+
+        if (_cache) _cache->insert(missed[k], num_results, missedResults[k]);
+        results[missedQueries[k]].swap(missedResults[k]);
+    }
+}
+
+
+size_t BofSearchManager::num_candidates(size_t num_results) const
+{
+    return _reranker ? std::max(num_results, _rerankCandidates) : num_results;
+}
+
+
+void BofSearchManager::rerank(const vec_f32_t& histvw, vector<dist_idx_t>& results, size_t num_results, query_cost& cost) const
+{
+    if (!_reranker) return;
+
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    _reranker->rerank(histvw, results, num_results);
+    cost.rerank_ms = boost::chrono::duration<double, boost::milli>(boost::chrono::steady_clock::now() - start).count();
+}
+
+
+void BofSearchManager::record_pruning(const InvertedIndex& index, const vec_f32_t& histvw, size_t num_results,
+                                      const vector<dist_idx_t>& results, const query_cost& cost) const
+{
+    if (!_pruning.enabled()) return;
+
+    // compare against the exact results to see how many of them we lose by pruning
+    double recall = -1;
+    if (_pruneRecallAt > 0)
+    {
+        vector<dist_idx_t> exact, pruned;
+        index.query(histvw, *_tf, *_idf, _pruneRecallAt, exact);
+        if (num_results >= _pruneRecallAt) pruned.assign(results.begin(), results.begin() + std::min(results.size(), _pruneRecallAt));
+        else index.query(histvw, *_tf, *_idf, _pruneRecallAt, pruned, _pruning);
+
+        vec_u32_t exactIds, prunedIds;
+        for (size_t i = 0; i < exact.size(); i++) exactIds.push_back(static_cast<uint32_t>(exact[i].second));
+        for (size_t i = 0; i < pruned.size(); i++) prunedIds.push_back(static_cast<uint32_t>(pruned[i].second));
+        std::sort(exactIds.begin(), exactIds.end());
+        std::sort(prunedIds.begin(), prunedIds.end());
+
+        vec_u32_t common;
+        std::set_intersection(exactIds.begin(), exactIds.end(), prunedIds.begin(), prunedIds.end(), std::back_inserter(common));
+        recall = exactIds.empty() ? 1.0 : static_cast<double>(common.size()) / exactIds.size();
+    }
+
+    boost::mutex::scoped_lock lock(_pruningMutex);
+    _pruningReport.add(cost);
+    if (recall >= 0) _pruningReport.add_recall(recall);
+}
+
+
+void BofSearchManager::query(const vec_f32_t& histvw, ResultCursor& cursor) const
+{
+    vector<float> accumulators;
+    const InvertedIndex& index = local_index();
+
+    query_cost cost;
+    index.score(histvw, *_tf, *_idf, accumulators, _pruning, &cost);
+    cursor.reset(accumulators, index.document_ids());
+
+    if (!_pruning.enabled()) return;
+
+    boost::mutex::scoped_lock lock(_pruningMutex);
+    _pruningReport.add(cost);
+}
+
+
+const InvertedIndex& BofSearchManager::local_index() const
+{
+    if (_replicas.empty()) return _index;
+
+    size_t node = static_cast<size_t>(numa::current_node());
+    return (node < _replicas.size() && _replicas[node]) ? *_replicas[node] : _index;
+}
+
+
+pruning_report BofSearchManager::pruning() const
+{
+    boost::mutex::scoped_lock lock(_pruningMutex);
+    return _pruningReport;
+}
+
+
+void pruning_report::add(const query_cost& cost)
+{
+    num_queries++;
+    num_terms += cost.num_terms;
+    num_scanned_terms += cost.num_scanned_terms;
+    num_postings += cost.num_postings;
+    num_scanned_postings += cost.num_scanned_postings;
+}
+
+
+void pruning_report::add_recall(double recall)
+{
+    num_recall_queries++;
+    recall_sum += recall;
+}
+
+
+pruning_report& pruning_report::operator+=(const pruning_report& other)
+{
+    num_queries += other.num_queries;
+    num_terms += other.num_terms;
+    num_scanned_terms += other.num_scanned_terms;
+    num_postings += other.num_postings;
+    num_scanned_postings += other.num_scanned_postings;
+    num_recall_queries += other.num_recall_queries;
+    recall_sum += other.recall_sum;
+    return *this;
+}
+
+
+void pruning_report::print(std::ostream& stream) const
+{
+    if (!num_queries) return;
+
+    stream << "query term pruning over " << num_queries << " queries: "
+           << static_cast<double>(num_scanned_terms) / num_queries << " of " << static_cast<double>(num_terms) / num_queries << " terms, "
+           << static_cast<double>(num_scanned_postings) / num_queries << " of " << static_cast<double>(num_postings) / num_queries << " postings ("
+           << (num_postings ? 100.0 * num_scanned_postings / num_postings : 100.0) << "%) scanned per query";
+    if (num_recall_queries) stream << ", average recall " << recall_sum / num_recall_queries;
+    stream << std::endl;
+}
+
+} // end namespace imdb
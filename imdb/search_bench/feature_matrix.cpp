@@ -0,0 +1,259 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "feature_matrix.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include <boost/lexical_cast.hpp>
+
+#include "property_reader.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SSE is always available on x64 and enabled by /arch:SSE or -msse on x86
+#if defined(_M_X64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FEATURE_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace imdb {
+
+namespace {
+
+// rows whose distances are computed at once before the top-k is updated,
+// the deadline is checked once per block
+const size_t block_rows = 256;
+
+// matrices of less than 1M floats (4MB) are not worth waking up the thread team
+const size_t min_parallel_floats = 1 << 20;
+
+
+// Per dimension operations of the metrics: step() combines a dimension of the
+// query and of a row, the steps are summed and finish() gives the distance.
+
+struct abs_diff
+{
+#ifdef FEATURE_MATRIX_SSE
+    static __m128 step(__m128 q, __m128 r) {return _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(q, r));}
+#endif
+    static float step(float q, float r) {return std::abs(q - r);}
+    static float finish(float s) {return s;}
+};
+
+struct squared_diff
+{
+#ifdef FEATURE_MATRIX_SSE
+    static __m128 step(__m128 q, __m128 r) {__m128 d = _mm_sub_ps(q, r); return _mm_mul_ps(d, d);}
+#endif
+    static float step(float q, float r) {float d = q - r; return d * d;}
+    static float finish(float s) {return s;}
+};
+
+struct squared_diff_sqrt : public squared_diff
+{
+    static float finish(float s) {return std::sqrt(s);}
+};
+
+struct product_one_minus
+{
+#ifdef FEATURE_MATRIX_SSE
+    static __m128 step(__m128 q, __m128 r) {return _mm_mul_ps(q, r);}
+#endif
+    static float step(float q, float r) {return q * r;}
+    static float finish(float s) {return 1.0f - s;}
+};
+
+
+// distance between the padded query and a row, stride is a multiple of 8
+template <class op_t>
+inline float row_distance(const float* query, const float* row, size_t stride)
+{
+#ifdef FEATURE_MATRIX_SSE
+    // two independent accumulators hide the latency of the additions
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    for (size_t i = 0; i < stride; i += 8)
+    {
+        s0 = _mm_add_ps(s0, op_t::step(_mm_loadu_ps(query + i), _mm_load_ps(row + i)));
+        s1 = _mm_add_ps(s1, op_t::step(_mm_loadu_ps(query + i + 4), _mm_load_ps(row + i + 4)));
+    }
+    s0 = _mm_add_ps(s0, s1);
+    s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+    s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+    return op_t::finish(_mm_cvtss_f32(s0));
+#else
+    float s = 0;
+    for (size_t i = 0; i < stride; i++) s += op_t::step(query[i], row[i]);
+    return op_t::finish(s);
+#endif
+}
+
+
+// Scans the blocks [first_block, end_block) into a max-heap of the best num_results
+// rows, same as linear_search(). Returns false if stopped by the deadline.
+template <class op_t>
+bool scan_blocks(const float* data, size_t rows, size_t stride, const float* query, size_t first_block, size_t end_block,
+                 size_t num_results, const Deadline& deadline, vector<dist_idx_t>& heap)
+{
+    float dist[block_rows];
+
+    for (size_t b = first_block; b < end_block; b++)
+    {
+        // every thread compares at least one block
+        if (b != first_block && deadline.expired()) return false;
+
+        const size_t first = b * block_rows;
+        const size_t count = std::min(block_rows, rows - first);
+
+        const float* row = data + first * stride;
+        for (size_t i = 0; i < count; i++, row += stride) dist[i] = row_distance<op_t>(query, row, stride);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (heap.size() < num_results)
+            {
+                heap.push_back(std::make_pair(dist[i], static_cast<index_t>(first + i)));
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (!heap.empty() && heap.front().first > dist[i])
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = std::make_pair(dist[i], static_cast<index_t>(first + i));
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+    }
+    return true;
+}
+
+
+template <class op_t>
+bool search_rows(const float* data, size_t rows, size_t stride, const float* query, size_t num_results, int num_threads,
+                 const Deadline& deadline, vector<dist_idx_t>& result)
+{
+    const size_t numBlocks = (rows + block_rows - 1) / block_rows;
+
+    int numThreads = 1;
+#ifdef _OPENMP
+    if (rows * stride >= min_parallel_floats) numThreads = (num_threads > 0) ? num_threads : omp_get_max_threads();
+#else
+    (void)num_threads;
+#endif
+    numThreads = std::max(1, std::min(numThreads, static_cast<int>(numBlocks)));
+
+    // allocated up front, nothing in the parallel region may throw
+    vector<vector<dist_idx_t> > heaps(numThreads);
+    for (int t = 0; t < numThreads; t++) heaps[t].reserve(num_results);
+    vector<char> complete(numThreads, 1);
+
+    #pragma omp parallel num_threads(numThreads) if (numThreads > 1)
+    {
+        int t = 0;
+        int n = 1;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+        n = omp_get_num_threads();
+#endif
+        // one contiguous range per thread, such that each streams through its part of the memory
+        const size_t begin = numBlocks * t / n;
+        const size_t end = numBlocks * (t + 1) / n;
+        complete[t] = scan_blocks<op_t>(data, rows, stride, query, begin, end, num_results, deadline, heaps[t]);
+    }
+
+    // merge the top-k of all threads
+    result.swap(heaps[0]);
+    for (int t = 1; t < numThreads; t++) result.insert(result.end(), heaps[t].begin(), heaps[t].end());
+
+    const size_t k = std::min(num_results, result.size());
+    std::partial_sort(result.begin(), result.begin() + k, result.end());
+    result.resize(k);
+
+    return std::find(complete.begin(), complete.end(), 0) == complete.end();
+}
+
+} // end anonymous namespace
+
+
+bool FeatureMatrix::metric_from_name(const string& distfn, metric_t& metric)
+{
+    if (distfn == "l1norm") metric = L1Norm;
+    else if (distfn == "l2norm") metric = L2Norm;
+    else if (distfn == "l2norm_squared") metric = L2NormSquared;
+    else if (distfn == "one_minus_dot") metric = OneMinusDot;
+    else return false;
+    return true;
+}
+
+
+FeatureMatrix::FeatureMatrix(const string& descriptor_file)
+    : _rows(0)
+    , _dims(0)
+    , _stride(0)
+{
+    PropertyReaderT<vec_f32_t> reader(descriptor_file);
+    _rows = static_cast<size_t>(reader.size());
+
+    vec_f32_t descriptor;
+    if (_rows > 0)
+    {
+        reader.get(descriptor, 0);
+        _dims = descriptor.size();
+    }
+    _stride = std::max<size_t>(8, (_dims + 7) / 8 * 8);
+
+    // zero initialized, i.e. the padding is zero, and interleaved over the
+    // NUMA nodes such that the threads of a scan use all memory controllers
+    _buffer.reset(new PageBuffer(_rows * _stride * sizeof(float), PageBuffer::interleave, false));
+
+    float* data = static_cast<float*>(_buffer->data());
+    for (size_t i = 0; i < _rows; i++)
+    {
+        if (i > 0) reader.get(descriptor, i);
+        if (descriptor.size() != _dims)
+        {
+            throw std::runtime_error("FeatureMatrix: descriptor " + boost::lexical_cast<string>(i) + " in " + descriptor_file
+                                     + " has " + boost::lexical_cast<string>(descriptor.size()) + " dimensions, expected " + boost::lexical_cast<string>(_dims));
+        }
+        std::copy(descriptor.begin(), descriptor.end(), data + i * _stride);
+    }
+}
+
+
+bool FeatureMatrix::search(const vec_f32_t& query, metric_t metric, size_t num_results, vector<dist_idx_t>& result,
+                           int num_threads, const Deadline& deadline) const
+{
+    if (query.size() != _dims)
+    {
+        throw std::runtime_error("FeatureMatrix: query has " + boost::lexical_cast<string>(query.size())
+                                 + " dimensions, expected " + boost::lexical_cast<string>(_dims));
+    }
+
+    result.clear();
+    if (_rows == 0 || num_results == 0) return true;
+
+    // padded with zeros like the rows
+    vector<float> padded(_stride, 0.0f);
+    std::copy(query.begin(), query.end(), padded.begin());
+
+    const float* data = static_cast<const float*>(_buffer->data());
+    switch (metric)
+    {
+    case L1Norm:        return search_rows<abs_diff>(data, _rows, _stride, &padded[0], num_results, num_threads, deadline, result);
+    case L2Norm:        return search_rows<squared_diff_sqrt>(data, _rows, _stride, &padded[0], num_results, num_threads, deadline, result);
+    case L2NormSquared: return search_rows<squared_diff>(data, _rows, _stride, &padded[0], num_results, num_threads, deadline, result);
+    case OneMinusDot:   return search_rows<product_one_minus>(data, _rows, _stride, &padded[0], num_results, num_threads, deadline, result);
+    }
+    throw std::runtime_error("FeatureMatrix: unknown metric");
+}
+
+} // end namespace imdb
@@ -0,0 +1,98 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef FEATURE_MATRIX_HPP
+#define FEATURE_MATRIX_HPP
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "types.hpp"
+#include "numa.hpp"
+#include "deadline.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief All global descriptors of a collection in one aligned, row-major matrix, searched with SIMD kernels.
+ *
+ * Compared to a vec_vec_f32_t, which needs one heap allocation per descriptor, the rows lie contiguously
+ * in memory and each is padded with zeros to a multiple of 8 floats, such that a scan streams through
+ * the memory sequentially and the distance kernels process 8 dimensions per step using SSE without any
+ * remainder loop. The padding does not change the distances of the supported metrics.
+ *
+ * search() splits the rows into contiguous ranges, one per OpenMP thread, each thread computes the distances
+ * of a block of rows at once and keeps its own top-k, the top-k of all threads are merged in the end.
+ * The distances may differ in the last bits from the reference functors in distance.hpp as the dimensions
+ * are summed in a different order.
+ */
+class FeatureMatrix : public boost::noncopyable
+{
+public:
+
+    /// Distance metrics with a SIMD kernel
+    enum metric_t
+    {
+        L1Norm,          ///< same as l1norm
+        L2Norm,          ///< same as l2norm
+        L2NormSquared,   ///< same as l2norm_squared
+        OneMinusDot      ///< same as one_minus_dot
+    };
+
+    /**
+     * @brief Looks up the kernel for a distance function name as used by distance_functions<T>.make().
+     * @return false if there is no kernel for \p distfn
+     */
+    static bool metric_from_name(const string& distfn, metric_t& metric);
+
+    /**
+     * @brief Loads all descriptors from a property file.
+     * @param descriptor_file Property file of vec_f32_t descriptors, all of the same size
+     * @throw std::runtime_error if the file cannot be read or the descriptors differ in size
+     */
+    FeatureMatrix(const string& descriptor_file);
+
+    /// Number of descriptors
+    size_t rows() const {return _rows;}
+
+    /// Number of dimensions of a descriptor
+    size_t dims() const {return _dims;}
+
+    /// Pointer to the first dimension of a descriptor, 32 byte aligned
+    const float* row(size_t i) const {return static_cast<const float*>(_buffer->data()) + i * _stride;}
+
+    /// Copies a descriptor
+    void get(size_t i, vec_f32_t& descriptor) const {descriptor.assign(row(i), row(i) + _dims);}
+
+    /**
+     * @brief Finds the descriptors with the smallest distance to \p query.
+     * @param query Query descriptor, must have dims() dimensions
+     * @param metric Distance metric
+     * @param num_results Number of results to return
+     * @param result Pairs of distance and row, best matches first, previous contents are discarded
+     * @param num_threads Number of threads to scan with, 0 to use as many as OpenMP would. Small
+     * matrices are always scanned by a single thread
+     * @param deadline [optional] stop scanning once this has passed, see linear_search()
+     * @return true if all rows have been compared, false if the search was stopped by the deadline
+     * @throw std::runtime_error if the query has the wrong number of dimensions
+     */
+    bool search(const vec_f32_t& query, metric_t metric, size_t num_results, vector<dist_idx_t>& result,
+                int num_threads = 0, const Deadline& deadline = Deadline()) const;
+
+private:
+
+    size_t                          _rows;
+    size_t                          _dims;
+    size_t                          _stride;
+    boost::scoped_ptr<PageBuffer>   _buffer;
+};
+
+} // end namespace imdb
+
+#endif // FEATURE_MATRIX_HPP
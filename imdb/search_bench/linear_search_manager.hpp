@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef LINEAR_SEARCH_HPP
+#define LINEAR_SEARCH_HPP
+
+#include "types.hpp"
+#include "linear_search_functions.hpp"
+#include "result_cache.hpp"
+#include "deadline.hpp"
+#include "feature_matrix.hpp"
+
+namespace imdb
+{
+
+/**
+ * @ingroup search
+ * @brief Linear search over data in a property file using a given distance metric.
+ *
+ * Encapsulates loading of the required datastructures and distance metric
+ * such that a search can be performed once the instance has been constructed.
+ * Note that this class loads \b all features into main memory, make sure
+ * that you have enough memory to do so.
+ *
+ * For the distance functions "l1norm", "l2norm", "l2norm_squared" and "one_minus_dot" the features are
+ * kept in a FeatureMatrix and searched with its SIMD kernels on several threads, all others are compared
+ * one by one using the linear_search() instantiated for them by linear_search_functions.
+ */
+class LinearSearchManager
+{
+    public:
+
+    typedef vec_f32_t descr_t;
+
+    /**
+     * @brief Constructs the LinearSearchManager, loads all required datastructures such that a query() can be performed.
+     * @param parameters boost::property_tree that must contain the following key/value pairs:
+     * - "descriptor_file": filename of the features file over which you want to perform linear search, e.g. "/tmp/tinyimage.features". The
+     * features file must have been created using a PropertyWriterT with T=vec_f32_t.
+     * - "distfn": distance function, can be "l1norm", "l2norm", "l2norm_squared" or any other sensible distance metric available
+     * via linear_search_functions<T>.make()
+     * - "cache_size_mb": [optional] if given, results of repeated queries are answered from a ResultCache
+     * using at most this many megabytes, see cache()
+     * - "num_threads": [optional] number of threads a FeatureMatrix is scanned with, default 0, i.e. as many as OpenMP would use
+     */
+    LinearSearchManager(const ptree& parameters);
+
+    /**
+     * @brief Perform a linear search with data as the query feature.
+     *
+     * The input feature is compared to all features from the property file specified in the constructor using
+     * the provided distance metric.
+     *
+     * @param data Query data, must have the same size as the features in the property file that has been loaded in the constructor
+     * @param num_results Number of results to be returned
+     * @param result A vector of imdb::dist_idx_t that holds the result indices in descending order of
+     * similarity (i.e. best matches are first in the vector). Any potentially existing contents
+     * of this vector are cleared before the new results are added. The result indices point at positions
+     * in the property file that has been searched.
+     * @param deadline [optional] stop comparing features once this has passed, see linear_search()
+     * @return true if all features have been compared, false if the search was stopped by the deadline
+     */
+    bool query(const vec_f32_t& data, size_t num_results, vector<dist_idx_t>& result, const Deadline& deadline = Deadline()) const;
+
+    /// Number of features searched
+    size_t size() const {return _matrix ? _matrix->rows() : _features.size();}
+
+    /**
+     * @brief Copies one of the features searched.
+     * @throw std::runtime_error if \p index is out of range
+     */
+    void feature(index_t index, vec_f32_t& descr) const;
+
+    /// Cache of query results, null unless "cache_size_mb" is given
+    const shared_ptr<ResultCache>& cache() const {return _cache;}
+
+    private:
+
+    // either the matrix, if there is a kernel for the distance function, or the features are loaded
+    shared_ptr<FeatureMatrix> _matrix;
+    FeatureMatrix::metric_t _metric;
+    int _numThreads;
+
+    vec_vec_f32_t _features;
+    linear_search_functions<vec_vec_f32_t>::searchfn_t _search;
+    shared_ptr<ResultCache> _cache;
+};
+
+} // namespace imdb
+
+#endif // LINEAR_SEARCH_HPP
@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "load_generator.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <cassert>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace imdb {
+
+namespace {
+
+// nearest-rank percentile of sorted values
+double percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+} // end anonymous namespace
+
+
+load_result::load_result()
+    : num_queries(0)
+    , num_errors(0)
+    , seconds(0)
+    , throughput(0)
+    , mean_ms(0)
+    , p50_ms(0)
+    , p95_ms(0)
+    , p99_ms(0)
+    , max_ms(0)
+    , cpu_utilization(0)
+{}
+
+
+void load_result::print(std::ostream& stream, const string& name) const
+{
+    const std::streamsize precision = stream.precision();
+    stream << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+           << std::setw(10) << throughput
+           << std::setprecision(3)
+           << std::setw(10) << mean_ms << std::setw(10) << p50_ms << std::setw(10) << p95_ms
+           << std::setw(10) << p99_ms << std::setw(10) << max_ms
+           << std::setprecision(1)
+           << std::setw(8) << cpu_utilization * 100 << "%"
+           << std::setw(10) << usage.memory_bytes / (1024.0 * 1024.0)
+           << std::setw(10) << usage.peak_memory_bytes / (1024.0 * 1024.0);
+    if (num_errors) stream << "  (" << num_errors << " failed)";
+    stream << std::endl;
+    stream.unsetf(std::ios_base::floatfield);
+    stream.precision(precision);
+}
+
+
+LoadGenerator::LoadGenerator(const vector<vec_f32_t>& queries, size_t num_results)
+    : _queries(queries)
+    , _numResults(num_results)
+    , _numQueries(0)
+    , _rate(0)
+    , _next(0)
+    , _numErrors(0)
+{}
+
+
+load_result LoadGenerator::run(const query_fn& query, size_t num_queries, int concurrency, double rate)
+{
+    assert(concurrency > 0);
+    if (_queries.empty()) throw std::runtime_error("LoadGenerator: no query descriptors");
+
+    _query = query;
+    _numQueries = num_queries;
+    _rate = rate;
+    _latencies.assign(num_queries, 0.0);
+    _next = 0;
+    _numErrors = 0;
+
+    const process_usage before = process_usage::current();
+    _start = clock::now();
+
+    boost::thread_group pool;
+    for (int i = 0; i < concurrency; i++)
+    {
+        pool.add_thread(new boost::thread(boost::bind(&LoadGenerator::thread_main, this)));
+    }
+    pool.join_all();
+
+    load_result result;
+    result.seconds = boost::chrono::duration<double>(clock::now() - _start).count();
+    result.usage = process_usage::current();
+    result.num_queries = num_queries;
+    result.num_errors = _numErrors;
+    result.throughput = result.seconds > 0 ? (num_queries - _numErrors) / result.seconds : 0;
+
+    const int num_processors = std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+    if (result.seconds > 0) result.cpu_utilization = (result.usage.cpu_seconds - before.cpu_seconds) / (result.seconds * num_processors);
+
+    std::sort(_latencies.begin(), _latencies.end());
+    if (!_latencies.empty())
+    {
+        result.mean_ms = std::accumulate(_latencies.begin(), _latencies.end(), 0.0) / _latencies.size();
+        result.p50_ms = percentile(_latencies, 50);
+        result.p95_ms = percentile(_latencies, 95);
+        result.p99_ms = percentile(_latencies, 99);
+        result.max_ms = _latencies.back();
+    }
+
+    return result;
+}
+
+
+void LoadGenerator::thread_main()
+{
+#ifdef _OPENMP
+    // the load threads are the parallelism, as in a server handling one query per thread
+    omp_set_num_threads(1);
+#endif
+
+    vector<dist_idx_t> results;
+
+    for (;;)
+    {
+        size_t i;
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            if (_next == _numQueries) break;
+            i = _next++;
+        }
+
+        // in an open loop the query is due at its arrival time, whether or not a thread was free
+        clock::time_point issued = clock::now();
+        if (_rate > 0)
+        {
+            const clock::time_point arrival = _start + boost::chrono::duration_cast<clock::duration>(boost::chrono::duration<double>(i / _rate));
+            if (arrival > issued) boost::this_thread::sleep_for(arrival - issued);
+            issued = arrival;
+        }
+
+        try {
+            results.clear();
+            _query(_queries[i % _queries.size()], _numResults, results);
+        }
+        catch (const std::exception& e)
+        {
+            boost::lock_guard<boost::mutex> lock(_mutex);
+            if (!_numErrors) std::cerr << "LoadGenerator: query " << i << " failed: " << e.what() << std::endl;
+            _numErrors++;
+        }
+
+        _latencies[i] = boost::chrono::duration<double, boost::milli>(clock::now() - issued).count();
+    }
+}
+
+} // end namespace imdb
@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#include <ostream>
+
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+#include "process_usage.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Throughput, latency and resource usage measured by a LoadGenerator run.
+ */
+struct load_result
+{
+    load_result();
+
+    /// Prints a one line summary prefixed by \p name
+    void print(std::ostream& stream, const string& name) const;
+
+    size_t num_queries;
+    size_t num_errors;
+    double seconds;           ///< wall clock time of the whole run
+    double throughput;        ///< finished queries per second
+
+    double mean_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+
+    double cpu_utilization;   ///< fraction of all processors kept busy during the run, in [0,1]
+    process_usage usage;      ///< snapshot taken at the end of the run
+};
+
+
+/**
+ * @ingroup search
+ * @brief Replays query descriptors against a search function and measures the latency of each query.
+ *
+ * Two load models are supported:
+ * - closed loop (rate == 0): each of the \p concurrency threads issues its next query as soon as the
+ *   previous one has finished, i.e. there are always exactly \p concurrency queries in flight. The
+ *   latency of a query is its service time.
+ * - open loop (rate > 0): queries arrive at a fixed rate independent of how fast they are served, query
+ *   i is due at i / rate seconds after the start. The latency is measured from the arrival time, so if
+ *   the \p concurrency threads cannot keep up with the rate, the time a query waits for a free thread
+ *   is part of its latency. This is what a client would observe and avoids the coordinated omission
+ *   of a closed loop benchmark.
+ *
+ * The descriptors are replayed in a cycle, so more queries than descriptors can be run.
+ */
+class LoadGenerator : public boost::noncopyable
+{
+public:
+
+    /// Runs a single query, e.g. bound to BofSearchManager::query or LinearSearchManager::query
+    typedef boost::function<void (const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& results)> query_fn;
+
+    /**
+     * @param queries Query descriptors, must outlive the generator
+     * @param num_results Number of results requested per query
+     */
+    LoadGenerator(const vector<vec_f32_t>& queries, size_t num_results);
+
+    /**
+     * @brief Runs \p num_queries queries and blocks until all of them are done.
+     * @param query Search function, called concurrently from \p concurrency threads
+     * @param num_queries Number of queries to run
+     * @param concurrency Number of threads issuing queries, must be > 0
+     * @param rate Arrival rate in queries per second for an open loop run, 0 for a closed loop run
+     */
+    load_result run(const query_fn& query, size_t num_queries, int concurrency, double rate = 0);
+
+private:
+
+    typedef boost::chrono::steady_clock clock;
+
+    void thread_main();
+
+    const vector<vec_f32_t>& _queries;
+    size_t                   _numResults;
+
+    query_fn                 _query;
+    size_t                   _numQueries;
+    double                   _rate;
+    clock::time_point        _start;
+
+    // latency of the i-th query, each slot is written by a single thread
+    vector<double>           _latencies;
+
+    size_t                   _next;
+    size_t                   _numErrors;
+    boost::mutex             _mutex;
+};
+
+} // end namespace imdb
+
+#endif // LOAD_GENERATOR_HPP
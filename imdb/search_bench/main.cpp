@@ -0,0 +1,293 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+//util/
+#include <types.hpp>
+#include <quantizer.hpp>
+#include <distance.hpp>
+//io/
+#include <cmdline.hpp>
+#include <property_reader.hpp>
+//search/
+#include <bof_search_manager.hpp>
+#include <linear_search_manager.hpp>
+#include <load_generator.hpp>
+#include <process_usage.hpp>
+
+
+using namespace imdb;
+
+
+namespace {
+
+// a search configuration to be benchmarked
+struct variant
+{
+    string name;
+    ptree  search_params;
+};
+
+typedef bool (BofSearchManager::*bof_query_t)(const vec_f32_t&, size_t, vector<dist_idx_t>&, query_cost*, const Deadline&) const;
+
+double megabytes(uint64_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+void print_header(std::ostream& stream)
+{
+    stream << std::left << std::setw(24) << "variant" << std::right
+           << std::setw(10) << "q/s" << std::setw(10) << "mean" << std::setw(10) << "p50"
+           << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max"
+           << std::setw(9) << "cpu" << std::setw(10) << "mem MB" << std::setw(10) << "peak MB" << std::endl;
+}
+
+} // end anonymous namespace
+
+
+class command_bench : public Command
+{
+public:
+
+    command_bench()
+        : Command("search_bench [options]")
+        , _co_descriptors("descriptors"    , "d", "filename of the query descriptors: histograms of visual words (as written by compute_histvw) or global descriptors, or local features per image if --vocabulary is given [required]")
+        , _co_vocabulary("vocabulary"      , "v", "filename of vocabulary, if given the descriptors are local features that are quantized into histograms of visual words before the benchmark [optional]")
+        , _co_search_ptree("searchptree"   , "s", "filename(s) of JSON files containing parameters for the search manager, each file is benchmarked as a separate variant [optional, if not provided, --searchparams must be given]")
+        , _co_search_params("searchparams" , "m", "parameters for the search manager of a single variant [optional, if not provided, --searchptree must be given]")
+        , _co_concurrency("concurrency"    , "c", "number(s) of threads issuing queries, each variant is run once per given number, default: number of processors [optional]")
+        , _co_rate("rate"                  , "a", "arrival rate in queries per second for an open loop benchmark, default: 0, i.e. closed loop [optional]")
+        , _co_num_queries("numqueries"     , "N", "number of measured queries per run, the descriptors are replayed in a cycle, default: number of descriptors [optional]")
+        , _co_warmup("warmup"              , "W", "number of queries run before each measurement and not measured, default: 100 [optional]")
+        , _co_num_results("numresults"     , "n", "number of results per query, default: 100 [optional]")
+    {
+        add(_co_descriptors);
+        add(_co_vocabulary);
+        add(_co_search_ptree);
+        add(_co_search_params);
+        add(_co_concurrency);
+        add(_co_rate);
+        add(_co_num_queries);
+        add(_co_warmup);
+        add(_co_num_results);
+    }
+
+
+    bool run(const std::vector<std::string>& args)
+    {
+
+        warn_for_unknown_option(args);
+
+        string in_descriptors;
+        string in_vocabulary;
+        vector<int> in_concurrency;
+        double in_rate = 0;
+        size_t in_num_queries = 0;
+        size_t in_warmup = 100;
+        size_t in_num_results = 100;
+
+        // check that the required options are available
+        vector<variant> variants;
+        if (!_co_descriptors.parse_single<string>(args, in_descriptors) || !parse_variants(args, variants))
+        {
+            print();
+            return false;
+        }
+
+        _co_vocabulary.parse_single<string>(args, in_vocabulary);
+        _co_rate.parse_single<double>(args, in_rate);
+        _co_num_queries.parse_single<size_t>(args, in_num_queries);
+        _co_warmup.parse_single<size_t>(args, in_warmup);
+        _co_num_results.parse_single<size_t>(args, in_num_results);
+        if (!_co_concurrency.parse_multiple<int>(args, in_concurrency))
+        {
+            in_concurrency.push_back(std::max(1, static_cast<int>(boost::thread::hardware_concurrency())));
+        }
+
+        for (size_t i = 0; i < in_concurrency.size(); i++)
+        {
+            if (in_concurrency[i] < 1)
+            {
+                std::cerr << "search_bench: concurrency must be at least 1" << std::endl;
+                return false;
+            }
+        }
+
+        try {
+            vector<vec_f32_t> queries;
+            load_queries(in_descriptors, in_vocabulary, queries);
+            if (queries.empty()) throw std::runtime_error("no query descriptors in " + in_descriptors);
+            if (!in_num_queries) in_num_queries = queries.size();
+
+            std::cout << "search_bench: " << queries.size() << " query descriptors, " << in_num_queries << " queries per run, "
+                      << (in_rate > 0 ? "open loop at " : "closed loop") ;
+            if (in_rate > 0) std::cout << in_rate << " queries/s";
+            std::cout << std::endl;
+
+            LoadGenerator generator(queries, in_num_results);
+
+            // the managers of all variants won't fit into memory for large indices, so
+            // each one is loaded, measured and released before the next one
+            vector<std::pair<string, load_result> > rows;
+            for (size_t v = 0; v < variants.size(); v++)
+            {
+                const process_usage before = process_usage::current();
+
+                shared_ptr<BofSearchManager> bof;
+                shared_ptr<LinearSearchManager> linear;
+                LoadGenerator::query_fn query;
+
+                const string search_type = variants[v].search_params.get<string>("search_type");
+                if (search_type == "BofSearch")
+                {
+                    bof.reset(new BofSearchManager(variants[v].search_params));
+                    query = boost::bind(static_cast<bof_query_t>(&BofSearchManager::query), bof.get(), _1, _2, _3, static_cast<query_cost*>(0), Deadline());
+                }
+                else if (search_type == "LinearSearch")
+                {
+                    linear.reset(new LinearSearchManager(variants[v].search_params));
+                    query = boost::bind(&LinearSearchManager::query, linear.get(), _1, _2, _3, Deadline());
+                }
+                else
+                {
+                    throw std::runtime_error("unsupported search type " + search_type);
+                }
+
+                std::cout << "search_bench: loaded " << variants[v].name << ", memory +"
+                          << std::fixed << std::setprecision(1) << (megabytes(process_usage::current().memory_bytes) - megabytes(before.memory_bytes)) << " MB" << std::endl;
+                std::cout.unsetf(std::ios_base::floatfield);
+
+                print_header(std::cout);
+                for (size_t c = 0; c < in_concurrency.size(); c++)
+                {
+                    if (in_warmup) generator.run(query, in_warmup, in_concurrency[c]);
+
+                    std::ostringstream name;
+                    name << variants[v].name << " c=" << in_concurrency[c];
+
+                    load_result result = generator.run(query, in_num_queries, in_concurrency[c], in_rate);
+                    rows.push_back(std::make_pair(name.str(), result));
+                    result.print(std::cout, name.str());
+                }
+
+                const shared_ptr<ResultCache>& cache = bof ? bof->cache() : linear->cache();
+                if (cache) cache->stats().print(std::cout);
+                if (bof && bof->pruning().num_queries) bof->pruning().print(std::cout);
+            }
+
+            // side by side comparison of all runs
+            if (rows.size() > 1)
+            {
+                std::cout << std::endl << "search_bench: comparison, latencies in ms" << std::endl;
+                print_header(std::cout);
+                for (size_t i = 0; i < rows.size(); i++) rows[i].second.print(std::cout, rows[i].first);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "search_bench: error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+
+    // one variant per search ptree file, or a single one from the search parameters
+    bool parse_variants(const std::vector<std::string>& args, vector<variant>& variants)
+    {
+        vector<string> in_searchptrees;
+        vector<string> in_searchparams;
+        if (_co_search_ptree.parse_multiple<string>(args, in_searchptrees))
+        {
+            for (size_t i = 0; i < in_searchptrees.size(); i++)
+            {
+                variant v;
+                v.name = in_searchptrees[i];
+                boost::property_tree::read_json(in_searchptrees[i], v.search_params);
+                variants.push_back(v);
+            }
+        }
+        else if (_co_search_params.parse_multiple<string>(args, in_searchparams))
+        {
+            variant v;
+            v.name = "searchparams";
+            for (size_t i = 0; i < in_searchparams.size(); i++)
+            {
+                vector<string> pv;
+                boost::algorithm::split(pv, in_searchparams[i], boost::algorithm::is_any_of("="));
+
+                if (pv.size() != 1 && pv.size() != 2)
+                {
+                    std::cerr << "search_bench: cannot parse search manager parameter: " << in_searchparams[i] << std::endl;
+                    return false;
+                }
+                v.search_params.put(pv[0], (pv.size() == 2) ? pv[1] : "");
+            }
+            variants.push_back(v);
+        }
+        return !variants.empty();
+    }
+
+    // histograms or global descriptors are used as they are, local features
+    // are quantized up front so that quantization is not part of the measurement
+    void load_queries(const string& descriptors, const string& vocabulary, vector<vec_f32_t>& queries)
+    {
+        if (vocabulary.empty())
+        {
+            read_property(queries, descriptors);
+            return;
+        }
+
+        vec_vec_f32_t words;
+        read_property(words, vocabulary);
+
+        vector<vec_vec_f32_t> features;
+        read_property(features, descriptors);
+
+        std::cout << "search_bench: quantizing " << features.size() << " queries against " << words.size() << " visual words" << std::endl;
+
+        quantize_fn quantizer = quantize_hard<vec_f32_t, imdb::l2norm_squared<vec_f32_t> >();
+        queries.resize(features.size());
+        for (size_t i = 0; i < features.size(); i++)
+        {
+            vec_vec_f32_t quantized;
+            quantize_samples_parallel(features[i], words, quantized, quantizer);
+            build_histvw(quantized, words.size(), queries[i], false);
+        }
+    }
+
+    CmdOption _co_descriptors;
+    CmdOption _co_vocabulary;
+    CmdOption _co_search_ptree;
+    CmdOption _co_search_params;
+    CmdOption _co_concurrency;
+    CmdOption _co_rate;
+    CmdOption _co_num_queries;
+    CmdOption _co_warmup;
+    CmdOption _co_num_results;
+};
+
+
+int main(int argc, char *argv[])
+{
+    command_bench cmd;
+    bool okay = cmd.run(argv_to_strings(argc-1, &argv[1]));
+    return okay ? 0:1;
+}
@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "numa.hpp"
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace imdb {
+
+#ifdef _WIN32
+
+namespace {
+
+// large pages can only be allocated by a process holding SeLockMemoryPrivilege,
+// which must be granted to the user and then enabled for the process token
+bool enable_lock_memory_privilege()
+{
+    static int enabled = -1;
+    if (enabled >= 0) return enabled == 1;
+
+    enabled = 0;
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+    {
+        // AdjustTokenPrivileges succeeds even if the privilege is not held
+        AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+        if (GetLastError() == ERROR_SUCCESS) enabled = 1;
+    }
+    CloseHandle(token);
+    return enabled == 1;
+}
+
+} // end anonymous namespace
+
+
+int numa::num_nodes()
+{
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest)) return 1;
+    return static_cast<int>(highest) + 1;
+}
+
+int numa::current_node()
+{
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+
+    USHORT node = 0;
+    if (!GetNumaProcessorNodeEx(&processor, &node)) return 0;
+    return node;
+}
+
+bool numa::pin_current_thread(int node)
+{
+    GROUP_AFFINITY affinity;
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) return false;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+}
+
+
+PageBuffer::PageBuffer(size_t bytes, int node, bool large_pages)
+    : _data(0)
+    , _size(bytes)
+    , _largePages(false)
+{
+    const HANDLE process = GetCurrentProcess();
+    const size_t allocSize = std::max<size_t>(bytes, 1);
+
+    if (node == interleave)
+    {
+        // reserve the address range once and commit it chunk by chunk,
+        // each chunk preferring the next node
+        const size_t chunk = 2 * 1024 * 1024;
+        const int numNodes = numa::num_nodes();
+
+        _data = VirtualAlloc(NULL, allocSize, MEM_RESERVE, PAGE_READWRITE);
+        if (!_data) throw std::bad_alloc();
+
+        for (size_t offset = 0, i = 0; offset < allocSize; offset += chunk, i++)
+        {
+            void* p = static_cast<char*>(_data) + offset;
+            if (!VirtualAllocExNuma(process, p, std::min(chunk, allocSize - offset), MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(i % numNodes)))
+            {
+                VirtualFree(_data, 0, MEM_RELEASE);
+                throw std::bad_alloc();
+            }
+        }
+        return;
+    }
+
+    if (large_pages && enable_lock_memory_privilege())
+    {
+        // the size of a large page allocation must be a multiple of the large page size
+        const size_t pageSize = GetLargePageMinimum();
+        if (pageSize)
+        {
+            size_t size = (allocSize + pageSize - 1) / pageSize * pageSize;
+            _data = VirtualAllocExNuma(process, NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, static_cast<DWORD>(node));
+            _largePages = (_data != 0);
+        }
+    }
+
+    if (!_data) _data = VirtualAllocExNuma(process, NULL, allocSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(node));
+    if (!_data) throw std::bad_alloc();
+}
+
+PageBuffer::~PageBuffer()
+{
+    VirtualFree(_data, 0, MEM_RELEASE);
+}
+
+#else
+
+// no NUMA support on other platforms, memory is placed by the
+// operating system (usually on the node of the first touching thread)
+
+int numa::num_nodes()
+{
+    return 1;
+}
+
+int numa::current_node()
+{
+    return 0;
+}
+
+bool numa::pin_current_thread(int /*node*/)
+{
+    return false;
+}
+
+
+PageBuffer::PageBuffer(size_t bytes, int /*node*/, bool large_pages)
+    : _data(0)
+    , _size(bytes)
+    , _largePages(false)
+{
+    // align to the huge page size, such that the kernel
+    // can back the buffer by transparent huge pages
+    const size_t alignment = 2 * 1024 * 1024;
+    const size_t allocSize = (std::max<size_t>(bytes, 1) + alignment - 1) / alignment * alignment;
+
+    if (posix_memalign(&_data, alignment, allocSize) != 0) throw std::bad_alloc();
+
+    // must be advised before the pages are touched for the first time
+#ifdef MADV_HUGEPAGE
+    if (large_pages) _largePages = (madvise(_data, allocSize, MADV_HUGEPAGE) == 0);
+#else
+    (void)large_pages;
+#endif
+
+    std::memset(_data, 0, allocSize);
+}
+
+PageBuffer::~PageBuffer()
+{
+    free(_data);
+}
+
+#endif
+
+} // end namespace imdb
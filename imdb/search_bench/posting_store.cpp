@@ -0,0 +1,103 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "posting_store.hpp"
+
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace imdb {
+
+// posting lists are read with a single read() per list, which
+// requires doc_freq_pair to be stored without any padding
+BOOST_STATIC_ASSERT(sizeof(ColdPostingStore::doc_freq_pair) == sizeof(uint32_t) + sizeof(float));
+
+ColdPostingStore::ColdPostingStore(const string& filename, uint32_t num_terms)
+    : _filename(filename)
+    , _locations(num_terms)
+    , _cold(num_terms, false)
+    , _numTerms(0)
+    , _numPostings(0)
+{}
+
+void ColdPostingStore::add(uint32_t term_id, const location& loc)
+{
+    if (!_cold[term_id])
+    {
+        _numTerms++;
+        _numPostings += loc.length;
+    }
+
+    _locations[term_id] = loc;
+    _cold[term_id] = true;
+}
+
+void ColdPostingStore::fetch(const vector<uint32_t>& terms, vector<vector<doc_freq_pair> >& frequencies, vector<vector<float> >& weights) const
+{
+    frequencies.resize(terms.size());
+    weights.resize(terms.size());
+
+    // exceptions must not leave an OpenMP parallel region, so we
+    // only remember that a read failed and throw afterwards
+    bool failed = false;
+
+    #pragma omp parallel for schedule(dynamic) reduction(||:failed)
+    for (int i = 0; i < static_cast<int>(terms.size()); i++)
+    {
+        assert(contains(terms[i]));
+        const location& loc = _locations[terms[i]];
+
+        frequencies[i].resize(loc.length);
+        weights[i].resize(loc.length);
+        if (loc.length == 0) continue;
+
+        shared_ptr<std::ifstream> stream = acquire();
+
+        stream->seekg(loc.frequency_offset);
+        stream->read(reinterpret_cast<char*>(&frequencies[i][0]), loc.length * sizeof(doc_freq_pair));
+        stream->seekg(loc.weight_offset);
+        stream->read(reinterpret_cast<char*>(&weights[i][0]), loc.length * sizeof(float));
+
+        if (!stream->good())
+        {
+            failed = true;
+            stream->clear();
+        }
+
+        // a stream that could not be opened would fail every
+        // later read, so it is not returned to the pool
+        if (stream->is_open()) release(stream);
+    }
+
+    if (failed) throw std::ios_base::failure("could not read posting lists from " + _filename);
+}
+
+shared_ptr<std::ifstream> ColdPostingStore::acquire() const
+{
+    {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        if (!_streams.empty())
+        {
+            shared_ptr<std::ifstream> stream = _streams.back();
+            _streams.pop_back();
+            return stream;
+        }
+    }
+
+    // all handles are busy, open a new one that will
+    // be added to the pool once it has been released
+    return shared_ptr<std::ifstream>(new std::ifstream(_filename.c_str(), std::ios::in | std::ios::binary));
+}
+
+void ColdPostingStore::release(const shared_ptr<std::ifstream>& stream) const
+{
+    boost::lock_guard<boost::mutex> lock(_mutex);
+    _streams.push_back(stream);
+}
+
+} // end namespace imdb
@@ -0,0 +1,91 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#include "process_usage.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+namespace imdb {
+
+#ifdef _WIN32
+
+namespace {
+
+double seconds(const FILETIME& t)
+{
+    ULARGE_INTEGER v;
+    v.LowPart = t.dwLowDateTime;
+    v.HighPart = t.dwHighDateTime;
+    return v.QuadPart * 1e-7;
+}
+
+} // end anonymous namespace
+
+
+process_usage process_usage::current()
+{
+    process_usage usage;
+
+    FILETIME creation, exit, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        usage.cpu_seconds = seconds(kernel) + seconds(user);
+    }
+
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        usage.memory_bytes = counters.WorkingSetSize;
+        usage.peak_memory_bytes = counters.PeakWorkingSetSize;
+    }
+
+    return usage;
+}
+
+#else
+
+process_usage process_usage::current()
+{
+    process_usage usage;
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        usage.cpu_seconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+        usage.peak_memory_bytes = static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+    }
+
+    // second field of statm is the resident set size in pages
+    if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+    {
+        unsigned long size, resident;
+        if (std::fscanf(statm, "%lu %lu", &size, &resident) == 2)
+        {
+            usage.memory_bytes = static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+        }
+        std::fclose(statm);
+    }
+
+    // both are sampled at different times by the kernel
+    usage.peak_memory_bytes = std::max(usage.peak_memory_bytes, usage.memory_bytes);
+
+    return usage;
+}
+
+#endif
+
+} // end namespace imdb
@@ -0,0 +1,36 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef PROCESS_USAGE_HPP
+#define PROCESS_USAGE_HPP
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @brief CPU time and memory used by the current process so far.
+ *
+ * The difference of the cpu_seconds of two snapshots divided by the elapsed wall clock time and
+ * the number of processors gives the CPU utilization in between.
+ */
+struct process_usage
+{
+    process_usage() : cpu_seconds(0), memory_bytes(0), peak_memory_bytes(0) {}
+
+    /// Snapshot of the current process
+    static process_usage current();
+
+    double   cpu_seconds;        ///< user and kernel time of all threads
+    uint64_t memory_bytes;       ///< current working set (resident set size)
+    uint64_t peak_memory_bytes;  ///< largest working set so far
+};
+
+} // end namespace imdb
+
+#endif // PROCESS_USAGE_HPP
@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2012 Mathias Eitz and Ronald Richter.
+All rights reserved.
+
+This file is part of the imdb library and is made available under
+the terms of the BSD license (see the LICENSE file).
+*/
+
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <list>
+#include <map>
+#include <ostream>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "types.hpp"
+
+namespace imdb {
+
+/**
+ * @ingroup search
+ * @brief Hit/miss counters of a ResultCache.
+ */
+struct result_cache_stats
+{
+    result_cache_stats() : hits(0), misses(0), evictions(0), entries(0), bytes(0), max_bytes(0) {}
+
+    /// Prints the counters and the hit rate
+    void print(std::ostream& stream) const;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;     ///< entries removed to stay below max_bytes
+    size_t   entries;       ///< entries currently cached
+    size_t   bytes;         ///< memory currently used by the entries
+    size_t   max_bytes;
+};
+
+
+/**
+ * @ingroup search
+ * @brief Least recently used cache of query results, keyed by the query descriptor.
+ *
+ * Repeated queries (preset sketches, refreshes, re-requests of a result page) are answered from the cache
+ * instead of being scored again. The key is the descriptor itself, i.e. the non-zero entries of the
+ * (sparse) histogram of visual words or of the feature vector; a hash of it is only used to find the
+ * entry. A cached result also answers queries for fewer results than it has been computed for. Each
+ * search manager owns its cache, so the search parameters (and the index or features loaded) are
+ * implicitly part of the key, call clear() whenever the searched data changes.
+ *
+ * All functions are thread-safe.
+ */
+class ResultCache : public boost::noncopyable
+{
+public:
+
+    /// @param max_bytes Memory cap for all entries (descriptors and results), least recently used entries are evicted first
+    ResultCache(size_t max_bytes);
+
+    /**
+     * @brief Looks up the results of a query.
+     * @param descr Query descriptor
+     * @param num_results Desired number of results
+     * @param results Receives the cached results on a hit
+     * @return true on a hit
+     */
+    bool lookup(const vec_f32_t& descr, size_t num_results, vector<dist_idx_t>& results);
+
+    /// Adds the results of a query computed for \p num_results results, replacing an entry computed for fewer results
+    void insert(const vec_f32_t& descr, size_t num_results, const vector<dist_idx_t>& results);
+
+    /// Removes all entries, e.g. after the index has been reloaded. The counters are kept.
+    void clear();
+
+    result_cache_stats stats() const;
+
+private:
+
+    typedef vector<pair<uint32_t, float> > key_t;
+
+    struct entry
+    {
+        uint64_t           hash;
+        key_t              key;
+        size_t             num_results;   // number of results the entry has been computed for
+        vector<dist_idx_t> results;
+        size_t             bytes;
+    };
+
+    typedef std::list<entry>                           list_t;
+    typedef std::multimap<uint64_t, list_t::iterator>  map_t;
+
+    static void make_key(const vec_f32_t& descr, key_t& key, uint64_t& hash);
+
+    // entry with the given key, _entries.end() if there is none
+    list_t::iterator find(const key_t& key, uint64_t hash);
+
+    void erase(list_t::iterator it);
+
+    // most recently used entries at the front
+    list_t              _entries;
+    map_t               _index;
+
+    result_cache_stats  _stats;
+    mutable boost::mutex _mutex;
+};
+
+} // end namespace imdb
+
+#endif // RESULT_CACHE_HPP